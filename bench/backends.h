@@ -0,0 +1,361 @@
+/**
+ * @file backends.h
+ * @author Nidal Guerouaja
+ * @version 0.1
+ *
+ * Tipi di elemento e backend usati da set_bench e set_replay
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef BACKENDS_H
+#define BACKENDS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include "../src/set.h"
+
+/**
+ * @brief struct che rappresenta un punto 3D
+ */
+struct Point3D {
+  int x, y, z;
+};
+
+/**
+ * @brief funtore numeri uguali
+ */
+struct int_equal {
+  bool operator()(int a, int b) const {
+    return (a == b);
+  }
+};
+
+/**
+ * @brief funtore sringhe uguali
+ */
+struct string_equal {
+  bool operator()(const std::string& a, const std::string& b) const {
+    return (a == b);
+  }
+};
+
+/**
+ * @brief funtore punti uguali
+ */
+struct point_equal {
+  bool operator()(const Point3D& a, const Point3D& b) const {
+    return (a.x == b.x && a.y == b.y && a.z == b.z);
+  }
+};
+
+/**
+ * @brief funtore punti in ordine lessicografico (per std::set e std::vector)
+ */
+struct point_less {
+  bool operator()(const Point3D& a, const Point3D& b) const {
+    return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+  }
+};
+
+/**
+ * @brief funtore hash di un punto (per std::unordered_set)
+ */
+struct point_hash {
+  std::size_t operator()(const Point3D& p) const {
+    std::size_t h = std::hash<int>()(p.x);
+    h = h * 31 + std::hash<int>()(p.y);
+    return h * 31 + std::hash<int>()(p.z);
+  }
+};
+
+/**
+ * @brief Funtori e dati di test per ogni tipo di elemento
+ *
+ * make(i) genera elementi distinti per i distinti, keep(x) è il predicato
+ * usato dai benchmark di filter_out
+ */
+template <typename T>
+struct element;
+
+template <>
+struct element<int> {
+  typedef int_equal equal;
+  typedef std::less<int> less;
+  typedef std::hash<int> hash;
+
+  static int make(std::size_t i) {
+    return static_cast<int>(i);
+  }
+
+  static bool keep(int x) {
+    return (x % 4 == 0);
+  }
+};
+
+template <>
+struct element<std::string> {
+  typedef string_equal equal;
+  typedef std::less<std::string> less;
+  typedef std::hash<std::string> hash;
+
+  static std::string make(std::size_t i) {
+    return "element-" + std::to_string(i);
+  }
+
+  static bool keep(const std::string& x) {
+    return ((x.back() - '0') % 4 == 0);
+  }
+};
+
+template <>
+struct element<Point3D> {
+  typedef point_equal equal;
+  typedef point_less less;
+  typedef point_hash hash;
+
+  static Point3D make(std::size_t i) {
+    int v = static_cast<int>(i);
+    return {v, v % 1000, -v};
+  }
+
+  static bool keep(const Point3D& p) {
+    return (p.x % 4 == 0);
+  }
+};
+
+/**
+ * @brief predicato di filter_out per il tipo T
+ */
+template <typename T>
+struct keep_pred {
+  bool operator()(const T& x) const {
+    return element<T>::keep(x);
+  }
+};
+
+// Backend: stessa interfaccia per Set e per i container standard
+
+/**
+ * @brief Set (single linked list)
+ *
+ * add e remove sono O(n), quindi le dimensioni sono limitate
+ */
+template <typename T>
+struct list_backend {
+  typedef T value_type;
+  typedef Set<T, typename element<T>::equal> container;
+  static constexpr std::size_t max_size = 10000;
+
+  static container build(const std::vector<T>& data) {
+    return container(data.begin(), data.end());
+  }
+
+  static bool insert(container& c, const T& x) {
+    return c.add(x);
+  }
+
+  static void erase(container& c, const T& x) {
+    c.remove(x);
+  }
+
+  static bool contains(const container& c, const T& x) {
+    return c.contains(x);
+  }
+
+  static void clear(container& c) {
+    c.clear();
+  }
+
+  static container unite(const container& a, const container& b) {
+    return a + b;
+  }
+
+  static container intersect(const container& a, const container& b) {
+    return a - b;
+  }
+
+  static container filter(const container& c) {
+    return filter_out(c, keep_pred<T>());
+  }
+};
+
+/**
+ * @brief std::unordered_set
+ */
+template <typename T>
+struct unordered_backend {
+  typedef T value_type;
+  typedef std::unordered_set<T, typename element<T>::hash,
+                             typename element<T>::equal>
+      container;
+  static constexpr std::size_t max_size = 10000000;
+
+  static container build(const std::vector<T>& data) {
+    return container(data.begin(), data.end());
+  }
+
+  static bool insert(container& c, const T& x) {
+    return c.insert(x).second;
+  }
+
+  static void erase(container& c, const T& x) {
+    c.erase(x);
+  }
+
+  static bool contains(const container& c, const T& x) {
+    return c.count(x) != 0;
+  }
+
+  static void clear(container& c) {
+    c.clear();
+  }
+
+  static container unite(const container& a, const container& b) {
+    container tmp(a);
+    tmp.insert(b.begin(), b.end());
+    return tmp;
+  }
+
+  static container intersect(const container& a, const container& b) {
+    const container& small = (a.size() < b.size()) ? a : b;
+    const container& big = (a.size() < b.size()) ? b : a;
+    container tmp;
+    for (const T& x : small) {
+      if (big.count(x) != 0) tmp.insert(x);
+    }
+    return tmp;
+  }
+
+  static container filter(const container& c) {
+    container tmp;
+    for (const T& x : c) {
+      if (element<T>::keep(x)) tmp.insert(x);
+    }
+    return tmp;
+  }
+};
+
+/**
+ * @brief std::set
+ */
+template <typename T>
+struct ordered_backend {
+  typedef T value_type;
+  typedef std::set<T, typename element<T>::less> container;
+  static constexpr std::size_t max_size = 10000000;
+
+  static container build(const std::vector<T>& data) {
+    return container(data.begin(), data.end());
+  }
+
+  static bool insert(container& c, const T& x) {
+    return c.insert(x).second;
+  }
+
+  static void erase(container& c, const T& x) {
+    c.erase(x);
+  }
+
+  static bool contains(const container& c, const T& x) {
+    return c.count(x) != 0;
+  }
+
+  static void clear(container& c) {
+    c.clear();
+  }
+
+  static container unite(const container& a, const container& b) {
+    container tmp(a);
+    tmp.insert(b.begin(), b.end());
+    return tmp;
+  }
+
+  static container intersect(const container& a, const container& b) {
+    container tmp;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(),
+                          std::inserter(tmp, tmp.end()), a.key_comp());
+    return tmp;
+  }
+
+  static container filter(const container& c) {
+    container tmp;
+    for (const T& x : c) {
+      if (element<T>::keep(x)) tmp.insert(tmp.end(), x);
+    }
+    return tmp;
+  }
+};
+
+/**
+ * @brief std::vector ordinato (ricerca binaria)
+ */
+template <typename T>
+struct sorted_vector_backend {
+  typedef T value_type;
+  typedef std::vector<T> container;
+  typedef typename element<T>::less less;
+  static constexpr std::size_t max_size = 10000000;
+
+  static container build(const std::vector<T>& data) {
+    container tmp(data);
+    std::sort(tmp.begin(), tmp.end(), less());
+    tmp.erase(
+        std::unique(tmp.begin(), tmp.end(), typename element<T>::equal()),
+        tmp.end());
+    return tmp;
+  }
+
+  static bool insert(container& c, const T& x) {
+    typename container::iterator it =
+        std::lower_bound(c.begin(), c.end(), x, less());
+    if (it != c.end() && !less()(x, *it)) return false;
+    c.insert(it, x);
+    return true;
+  }
+
+  static void erase(container& c, const T& x) {
+    typename container::iterator it =
+        std::lower_bound(c.begin(), c.end(), x, less());
+    if (it != c.end() && !less()(x, *it)) c.erase(it);
+  }
+
+  static bool contains(const container& c, const T& x) {
+    return std::binary_search(c.begin(), c.end(), x, less());
+  }
+
+  static void clear(container& c) {
+    c.clear();
+  }
+
+  static container unite(const container& a, const container& b) {
+    container tmp;
+    tmp.reserve(a.size() + b.size());
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(),
+                   std::back_inserter(tmp), less());
+    return tmp;
+  }
+
+  static container intersect(const container& a, const container& b) {
+    container tmp;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(),
+                          std::back_inserter(tmp), less());
+    return tmp;
+  }
+
+  static container filter(const container& c) {
+    container tmp;
+    std::copy_if(c.begin(), c.end(), std::back_inserter(tmp), keep_pred<T>());
+    return tmp;
+  }
+};
+
+#endif  // BACKENDS_H
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "backends.h"
+#include "benchmark/benchmark.h"
+
+// contatori delle allocazioni fatte tramite l'operatore new globale
+static std::size_t allocations = 0;
+static std::size_t allocated_bytes = 0;
+
+void* operator new(std::size_t size) {
+  allocations++;
+  allocated_bytes += size;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+// elementi aggiunti o rimossi per ogni iterazione dei benchmark add/remove
+constexpr std::size_t BATCH_SIZE = 16;
+
+/**
+ * @brief n elementi distinti, in ordine casuale (seed fisso)
+ *
+ * @param n numero di elementi
+ * @param first indice del primo elemento
+ */
+template <typename T>
+std::vector<T> make_data(std::size_t n, std::size_t first = 0) {
+  std::vector<T> data;
+  data.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    data.push_back(element<T>::make(first + i));
+  }
+  std::shuffle(data.begin(), data.end(), std::mt19937(42));
+  return data;
+}
+
+/**
+ * @brief Misura allocazioni e byte per elemento di una costruzione
+ *
+ * viene fatta una costruzione in più fuori dal tempo misurato
+ */
+template <typename F>
+void report_memory(benchmark::State& state, F build, std::size_t n) {
+  std::size_t allocations_before = allocations;
+  std::size_t bytes_before = allocated_bytes;
+  {
+    auto c = build();
+    benchmark::DoNotOptimize(c);
+    // letti prima di scrivere in state.counters, che può allocare
+    std::size_t built_allocations = allocations - allocations_before;
+    std::size_t built_bytes = allocated_bytes - bytes_before;
+    state.counters["allocs_per_elem"] =
+        static_cast<double>(built_allocations) / n;
+    state.counters["bytes_per_elem"] = static_cast<double>(built_bytes) / n;
+  }
+}
+
+template <typename B>
+void BM_construct(benchmark::State& state) {
+  typedef typename B::value_type T;
+  std::size_t n = state.range(0);
+  std::vector<T> data = make_data<T>(n);
+
+  for (auto _ : state) {
+    typename B::container c = B::build(data);
+    benchmark::DoNotOptimize(c);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+  report_memory(state, [&] { return B::build(data); }, n);
+}
+
+template <typename B>
+void BM_add_hit(benchmark::State& state) {
+  typedef typename B::value_type T;
+  std::size_t n = state.range(0);
+  std::vector<T> data = make_data<T>(n);
+  typename B::container c = B::build(data);
+
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < BATCH_SIZE; ++i) {
+      benchmark::DoNotOptimize(B::insert(c, data[(i * 7919) % n]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
+}
+
+template <typename B>
+void BM_add_miss(benchmark::State& state) {
+  typedef typename B::value_type T;
+  std::size_t n = state.range(0);
+  std::vector<T> data = make_data<T>(n);
+  std::vector<T> misses = make_data<T>(BATCH_SIZE, n);
+  typename B::container base = B::build(data);
+  typename B::container c;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    c = base;
+    state.ResumeTiming();
+    for (std::size_t i = 0; i < BATCH_SIZE; ++i) {
+      benchmark::DoNotOptimize(B::insert(c, misses[i]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
+}
+
+template <typename B>
+void BM_remove(benchmark::State& state) {
+  typedef typename B::value_type T;
+  std::size_t n = state.range(0);
+  std::vector<T> data = make_data<T>(n);
+  typename B::container base = B::build(data);
+  typename B::container c;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    c = base;
+    state.ResumeTiming();
+    for (std::size_t i = 0; i < BATCH_SIZE && i < n; ++i) {
+      B::erase(c, data[i]);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * std::min(BATCH_SIZE, n));
+}
+
+template <typename B>
+void BM_union(benchmark::State& state) {
+  typedef typename B::value_type T;
+  std::size_t n = state.range(0);
+  // a e b hanno metà degli elementi in comune
+  typename B::container a = B::build(make_data<T>(n));
+  typename B::container b = B::build(make_data<T>(n, n / 2));
+
+  for (auto _ : state) {
+    typename B::container c = B::unite(a, b);
+    benchmark::DoNotOptimize(c);
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * n);
+}
+
+template <typename B>
+void BM_intersection(benchmark::State& state) {
+  typedef typename B::value_type T;
+  std::size_t n = state.range(0);
+  typename B::container a = B::build(make_data<T>(n));
+  typename B::container b = B::build(make_data<T>(n, n / 2));
+
+  for (auto _ : state) {
+    typename B::container c = B::intersect(a, b);
+    benchmark::DoNotOptimize(c);
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * n);
+}
+
+template <typename B>
+void BM_filter_out(benchmark::State& state) {
+  typedef typename B::value_type T;
+  std::size_t n = state.range(0);
+  typename B::container c = B::build(make_data<T>(n));
+
+  for (auto _ : state) {
+    typename B::container f = B::filter(c);
+    benchmark::DoNotOptimize(f);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+template <typename B>
+void BM_copy(benchmark::State& state) {
+  typedef typename B::value_type T;
+  std::size_t n = state.range(0);
+  typename B::container c = B::build(make_data<T>(n));
+
+  for (auto _ : state) {
+    typename B::container copy(c);
+    benchmark::DoNotOptimize(copy);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+  report_memory(state, [&] { return typename B::container(c); }, n);
+}
+
+template <typename B>
+void BM_iterate(benchmark::State& state) {
+  typedef typename B::value_type T;
+  std::size_t n = state.range(0);
+  typename B::container c = B::build(make_data<T>(n));
+
+  for (auto _ : state) {
+    for (const T& x : c) benchmark::DoNotOptimize(&x);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+/**
+ * @brief dimensioni da 10 a B::max_size, moltiplicate per 10
+ */
+template <typename B>
+void sizes(benchmark::internal::Benchmark* b) {
+  b->RangeMultiplier(10)->Range(10, B::max_size);
+}
+
+#define SET_BENCHMARKS(backend)                                      \
+  BENCHMARK_TEMPLATE(BM_construct, backend)->Apply(sizes<backend>);  \
+  BENCHMARK_TEMPLATE(BM_add_hit, backend)->Apply(sizes<backend>);    \
+  BENCHMARK_TEMPLATE(BM_add_miss, backend)->Apply(sizes<backend>);   \
+  BENCHMARK_TEMPLATE(BM_remove, backend)->Apply(sizes<backend>);     \
+  BENCHMARK_TEMPLATE(BM_union, backend)->Apply(sizes<backend>);      \
+  BENCHMARK_TEMPLATE(BM_intersection, backend)->Apply(sizes<backend>); \
+  BENCHMARK_TEMPLATE(BM_filter_out, backend)->Apply(sizes<backend>); \
+  BENCHMARK_TEMPLATE(BM_copy, backend)->Apply(sizes<backend>);       \
+  BENCHMARK_TEMPLATE(BM_iterate, backend)->Apply(sizes<backend>)
+
+// Set e container standard, per ognuno dei tipi usati nei test
+typedef list_backend<int> list_int;
+typedef list_backend<std::string> list_string;
+typedef list_backend<Point3D> list_point;
+typedef unordered_backend<int> unordered_int;
+typedef unordered_backend<std::string> unordered_string;
+typedef unordered_backend<Point3D> unordered_point;
+typedef ordered_backend<int> ordered_int;
+typedef ordered_backend<std::string> ordered_string;
+typedef ordered_backend<Point3D> ordered_point;
+typedef sorted_vector_backend<int> sorted_vector_int;
+typedef sorted_vector_backend<std::string> sorted_vector_string;
+typedef sorted_vector_backend<Point3D> sorted_vector_point;
+
+SET_BENCHMARKS(list_int);
+SET_BENCHMARKS(list_string);
+SET_BENCHMARKS(list_point);
+SET_BENCHMARKS(unordered_int);
+SET_BENCHMARKS(unordered_string);
+SET_BENCHMARKS(unordered_point);
+SET_BENCHMARKS(ordered_int);
+SET_BENCHMARKS(ordered_string);
+SET_BENCHMARKS(ordered_point);
+SET_BENCHMARKS(sorted_vector_int);
+SET_BENCHMARKS(sorted_vector_string);
+SET_BENCHMARKS(sorted_vector_point);
+
+BENCHMARK_MAIN();
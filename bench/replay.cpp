@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../src/trace.h"
+#include "backends.h"
+
+// nomi delle operazioni, nell'ordine di set_op
+static const char* const op_names[] = {"add",  "remove",    "find",
+                                       "unite", "intersect", "filter",
+                                       "copy", "clear",     "destroy"};
+// numero di operazioni
+constexpr std::size_t OPS = static_cast<std::size_t>(set_op::count);
+static_assert(sizeof(op_names) / sizeof(op_names[0]) == OPS,
+              "manca il nome di un'operazione");
+
+/**
+ * @brief Contatori hardware letti con perf_event_open (solo Linux)
+ *
+ * se il kernel non permette di aprirli (es. perf_event_paranoid o
+ * container) available() è false e la replay continua senza
+ */
+class perf_counters {
+ public:
+  // numero di contatori
+  static constexpr std::size_t size = 4;
+
+  perf_counters() : _available(false) {
+    for (std::size_t i = 0; i < size; ++i) _fd[i] = -1;
+#ifdef __linux__
+    const std::uint64_t configs[size] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    _available = true;
+    for (std::size_t i = 0; i < size && _available; ++i) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      _fd[i] = static_cast<int>(
+          syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+      if (_fd[i] < 0) _available = false;
+    }
+#endif
+  }
+
+  perf_counters(const perf_counters&) = delete;
+  perf_counters& operator=(const perf_counters&) = delete;
+
+  ~perf_counters() {
+#ifdef __linux__
+    for (std::size_t i = 0; i < size; ++i) {
+      if (_fd[i] >= 0) close(_fd[i]);
+    }
+#endif
+  }
+
+  bool available() const {
+    return _available;
+  }
+
+  void start() {
+#ifdef __linux__
+    for (std::size_t i = 0; i < size && _available; ++i) {
+      ioctl(_fd[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  void stop() {
+#ifdef __linux__
+    for (std::size_t i = 0; i < size && _available; ++i) {
+      ioctl(_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+#endif
+  }
+
+  /**
+   * @brief Valore di un contatore (0 se non disponibile)
+   */
+  std::uint64_t value(std::size_t i) const {
+    std::uint64_t v = 0;
+#ifdef __linux__
+    if (_available && read(_fd[i], &v, sizeof(v)) != sizeof(v)) v = 0;
+#endif
+    return v;
+  }
+
+  static const char* name(std::size_t i) {
+    static const char* const names[size] = {"cycles", "instructions",
+                                            "cache-misses", "branch-misses"};
+    return names[i];
+  }
+
+ private:
+  bool _available;
+  int _fd[size];
+};
+
+/**
+ * @brief Percentile di latenze già ordinate
+ */
+static std::uint64_t percentile(const std::vector<std::uint64_t>& sorted,
+                                double q) {
+  std::size_t i = static_cast<std::size_t>(q * sorted.size());
+  return sorted[std::min(i, sorted.size() - 1)];
+}
+
+/**
+ * @brief Riesegue la trace sul backend B e stampa i risultati
+ *
+ * ogni set della trace diventa un container di B, le chiavi diventano
+ * elementi con element<T>::make(chiave) e filter usa keep_pred<T> (il
+ * predicato originale non è nella trace)
+ *
+ * @param records operazioni della trace
+ * @param name nome del backend
+ * @param perf true per leggere i contatori hardware
+ */
+template <typename B>
+int replay(const std::vector<trace_record>& records, const std::string& name,
+           bool perf) {
+  typedef typename B::value_type T;
+  typedef typename B::container container;
+  typedef std::chrono::steady_clock clock;
+
+  std::vector<std::uint64_t> latencies[OPS];
+  std::unordered_map<std::uint32_t, container> sets;
+  const container empty;
+  std::size_t hits = 0;
+
+  perf_counters counters;
+  if (perf) counters.start();
+  clock::time_point begin = clock::now();
+
+  for (const trace_record& r : records) {
+    // l'elemento e i container vengono preparati fuori dal tempo misurato
+    T value = element<T>::make(static_cast<std::size_t>(r.key));
+    container& c = sets[r.set];
+    const container& a = (r.a != 0) ? sets[r.a] : empty;
+    const container& b = (r.b != 0) ? sets[r.b] : empty;
+
+    clock::time_point t = clock::now();
+    switch (r.op) {
+      case set_op::add:
+        hits += B::insert(c, value);
+        break;
+      case set_op::remove:
+        B::erase(c, value);
+        break;
+      case set_op::find:
+        hits += B::contains(c, value);
+        break;
+      case set_op::unite:
+        c = B::unite(a, b);
+        break;
+      case set_op::intersect:
+        c = B::intersect(a, b);
+        break;
+      case set_op::filter:
+        c = B::filter(a);
+        break;
+      case set_op::copy:
+        if (&c != &a) c = a;
+        break;
+      case set_op::clear:
+        B::clear(c);
+        break;
+      case set_op::destroy:
+        sets.erase(r.set);
+        break;
+      default:
+        break;
+    }
+    latencies[static_cast<std::size_t>(r.op)].push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t)
+            .count());
+  }
+
+  double seconds =
+      std::chrono::duration<double>(clock::now() - begin).count();
+  if (perf) counters.stop();
+
+  std::cout << name << ": " << records.size() << " operations in "
+            << seconds << " s (" << hits << " hits)\n\n";
+  std::cout << std::left << std::setw(10) << "op" << std::right
+            << std::setw(10) << "count" << std::setw(14) << "ops/s"
+            << std::setw(10) << "p50 ns" << std::setw(10) << "p99 ns"
+            << std::setw(12) << "p99.9 ns" << std::setw(12) << "max ns"
+            << "\n";
+  for (std::size_t i = 0; i < OPS; ++i) {
+    std::vector<std::uint64_t>& l = latencies[i];
+    if (l.empty()) continue;
+    std::sort(l.begin(), l.end());
+    std::uint64_t total = 0;
+    for (std::uint64_t ns : l) total += ns;
+    double throughput = (total == 0) ? 0 : l.size() * 1e9 / total;
+    std::cout << std::left << std::setw(10) << op_names[i] << std::right
+              << std::setw(10) << l.size() << std::setw(14)
+              << static_cast<std::uint64_t>(throughput) << std::setw(10)
+              << percentile(l, 0.5) << std::setw(10) << percentile(l, 0.99)
+              << std::setw(12) << percentile(l, 0.999) << std::setw(12)
+              << l.back() << "\n";
+  }
+
+  if (perf) {
+    std::cout << "\n";
+    if (!counters.available()) {
+      std::cout << "hardware counters unavailable (perf_event_open failed)\n";
+    } else {
+      for (std::size_t i = 0; i < perf_counters::size; ++i) {
+        std::uint64_t v = counters.value(i);
+        std::cout << std::left << std::setw(16) << perf_counters::name(i)
+                  << std::right << std::setw(16) << v << std::setw(12)
+                  << std::fixed << std::setprecision(2)
+                  << static_cast<double>(v) / std::max<std::size_t>(
+                                                  records.size(), 1)
+                  << " per op\n";
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Sceglie il backend per il tipo di elemento T
+ */
+template <typename T>
+int replay_type(const std::vector<trace_record>& records,
+                const std::string& backend, const std::string& type,
+                bool perf) {
+  std::string name = backend + "<" + type + ">";
+  if (backend == "list") return replay<list_backend<T> >(records, name, perf);
+  if (backend == "unordered") {
+    return replay<unordered_backend<T> >(records, name, perf);
+  }
+  if (backend == "ordered") {
+    return replay<ordered_backend<T> >(records, name, perf);
+  }
+  if (backend == "sorted_vector") {
+    return replay<sorted_vector_backend<T> >(records, name, perf);
+  }
+  std::cerr << "unknown backend " << backend << "\n";
+  return 2;
+}
+
+static int usage() {
+  std::cerr << "usage: set_replay <trace> [--backend "
+               "list|unordered|ordered|sorted_vector]\n"
+               "                  [--type int|string|point] [--perf]\n";
+  return 2;
+}
+
+int main(int argc, char* argv[]) {
+  std::string path;
+  std::string backend = "list";
+  std::string type = "int";
+  bool perf = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--backend" && i + 1 < argc) {
+      backend = argv[++i];
+    } else if (arg == "--type" && i + 1 < argc) {
+      type = argv[++i];
+    } else if (arg == "--perf") {
+      perf = true;
+    } else if (path.empty() && arg[0] != '-') {
+      path = arg;
+    } else {
+      return usage();
+    }
+  }
+  if (path.empty()) return usage();
+
+  std::vector<trace_record> records;
+  try {
+    trace_reader reader(path);
+    trace_record r;
+    while (reader.next(r)) records.push_back(r);
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  if (type == "int") return replay_type<int>(records, backend, type, perf);
+  if (type == "string") {
+    return replay_type<std::string>(records, backend, type, perf);
+  }
+  if (type == "point") {
+    return replay_type<Point3D>(records, backend, type, perf);
+  }
+  std::cerr << "unknown type " << type << "\n";
+  return 2;
+}
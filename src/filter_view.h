@@ -0,0 +1,184 @@
+/**
+ * @file filter_view.h
+ * @author Nidal Guerouaja
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef FILTER_VIEW_H
+#define FILTER_VIEW_H
+
+#include "set.h"
+
+/**
+ * @brief Vista materializzata di filter_out(base, pred)
+ *
+ * Contiene gli stessi elementi di filter_out(base, pred) ma invece di essere
+ * ricalcolata viene aggiornata ad ogni modifica del set base:
+ * - add: O(1), l'elemento è già distinto quindi viene solo messo in coda
+ * - remove: nessun costo se l'elemento non soddisfa pred, altrimenti una
+ *   sola scansione della vista (mai più lunga di quella fatta dalla remove
+ *   del set base)
+ * - clear: la vista viene svuotata
+ *
+ * Se l'allocazione di un nodo della vista fallisce, l'aggiunta al set base
+ * viene annullata e std::bad_alloc arriva al chiamante, quindi la vista non
+ * resta mai diversa dal set base.
+ *
+ * Il predicato deve dare sempre lo stesso risultato per lo stesso elemento.
+ * Se il set base viene distrutto la vista resta con gli ultimi elementi.
+ *
+ * @tparam T tipo del set
+ * @tparam Eql operatore di confronto del set
+ * @tparam Sketch sketch del set
+ * @tparam Instr policy di instrumentation del set
+ * @tparam P predicato
+ */
+template <typename T, typename Eql, typename Sketch, typename Instr,
+          typename P>
+class FilterView : public SetObserver<T> {
+ public:
+  // tipo del set base e del set materializzato
+  typedef Set<T, Eql, Sketch, Instr> set_type;
+  // iteratore sugli elementi della vista
+  typedef typename set_type::const_iterator const_iterator;
+
+  /**
+   * @brief Costruisce la vista e la registra sul set base
+   *
+   * @param base set da osservare
+   * @param pred il predicato da applicare agli element del set
+   * @throws std::bad_alloc possibile eccezione di allocazione
+   */
+  FilterView(set_type& base, P pred)
+      : _base(&base), _pred(pred), _tail(nullptr) {
+    for (const node* current = base._head_set; current != nullptr;
+         current = current->next) {
+      if (_pred(current->node_value)) _set._append(current->node_value, _tail);
+    }
+    _base->subscribe(this);
+  }
+
+  // la vista è registrata tramite il suo indirizzo
+  FilterView(const FilterView&) = delete;
+  FilterView& operator=(const FilterView&) = delete;
+
+  /**
+   * @brief Distruttore, la vista viene rimossa dal set base
+   */
+  ~FilterView() {
+    if (_base != nullptr) _base->unsubscribe(this);
+  }
+
+  /**
+   * @brief Il set materializzato
+   *
+   * @return const set_type& elementi del set base che soddisfano il predicato
+   */
+  const set_type& set() const {
+    return _set;
+  }
+
+  /**
+   * @brief Dimensione della vista
+   *
+   * @return u_int numero di elementi che soddisfano il predicato
+   */
+  typename set_type::u_int size() const {
+    return _set.size();
+  }
+
+  /**
+   * @brief Controlla se la vista è ancora collegata al set base
+   *
+   * @return false se il set base è stato distrutto
+   */
+  bool is_attached() const {
+    return _base != nullptr;
+  }
+
+  /**
+   * @brief Ritorna l'iteratore per l'inizio della sequenza di dati
+   */
+  const_iterator begin() const {
+    return _set.begin();
+  }
+
+  /**
+   * @brief Ritorna l'iteratore per la fine della sequenza di dati
+   */
+  const_iterator end() const {
+    return _set.end();
+  }
+
+  /**
+   * @brief Elemento aggiunto al set base, se soddisfa pred va in coda
+   *
+   * @param value elemento aggiunto
+   * @throws std::bad_alloc possibile eccezione di allocazione
+   */
+  void on_add(const T& value) override {
+    if (_pred(value)) _set._append(value, _tail);
+  }
+
+  /**
+   * @brief Elemento rimosso dal set base, viene tolto anche dalla vista
+   *
+   * @param value elemento rimosso
+   */
+  void on_remove(const T& value) override {
+    // una sola scansione, che aggiorna anche _tail se viene rimossa la coda
+    if (_pred(value)) _set._remove(value, &_tail);
+  }
+
+  /**
+   * @brief Il set base è stato svuotato
+   */
+  void on_clear() override {
+    _set.clear();
+    _tail = nullptr;
+  }
+
+  /**
+   * @brief Il set base è stato distrutto
+   */
+  void on_detach() override {
+    _base = nullptr;
+  }
+
+ private:
+  typedef typename set_type::node node;
+
+  // set osservato (nullptr se distrutto)
+  set_type* _base;
+  // predicato della vista
+  P _pred;
+  // elementi che soddisfano il predicato
+  set_type _set;
+  // ultimo nodo di _set, per aggiungere in O(1)
+  node* _tail;
+};
+
+/**
+ * @brief Crea una vista incrementale di filter_out(base, pred)
+ *
+ * @tparam T tipo del set
+ * @tparam Eql operatore di confronto del set
+ * @tparam Sketch sketch del set
+ * @tparam Instr policy di instrumentation del set
+ * @tparam P predicato
+ * @param base set da osservare
+ * @param pred il predicato da applicare agli element del set
+ * @return FilterView<T, Eql, Sketch, Instr, P> la vista, già registrata su
+ * base
+ * @throws std::bad_alloc possibile eccezione di allocazione
+ */
+template <typename T, typename Eql, typename Sketch, typename Instr,
+          typename P>
+FilterView<T, Eql, Sketch, Instr, P> make_filter_view(
+    Set<T, Eql, Sketch, Instr>& base, P pred) {
+  return FilterView<T, Eql, Sketch, Instr, P>(base, pred);
+}
+
+#endif  // FILTER_VIEW_H
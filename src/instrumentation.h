@@ -0,0 +1,346 @@
+/**
+ * @file instrumentation.h
+ * @author Nidal Guerouaja
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <algorithm>  // std::find, std::max
+#include <atomic>     // std::atomic
+#include <chrono>     // std::chrono::steady_clock
+#include <cstddef>    // std::size_t
+#include <mutex>      // std::mutex, std::lock_guard
+#include <vector>     // std::vector
+
+#include "set.h"
+
+/**
+ * @brief Contatori raccolti da counting_instrumentation
+ *
+ * i vettori sono indicizzati con set_op (es. calls[set_op_index(set_op::add)])
+ */
+struct set_stats {
+  // numero di operazioni misurate (set_op::count)
+  static constexpr std::size_t ops = static_cast<std::size_t>(set_op::count);
+
+  // nodi allocati
+  unsigned long long allocations;
+  // byte allocati per i nodi
+  unsigned long long allocated_bytes;
+  // chiamate di ogni operazione
+  unsigned long long calls[ops];
+  // nodi visitati (= confronti Eql) da add, remove e find
+  unsigned long long scanned[ops];
+  // scansione più lunga di add, remove e find
+  unsigned long long max_scan[ops];
+  // tempo passato in unite, intersect, filter e copy
+  unsigned long long nanoseconds[ops];
+};
+
+/**
+ * @brief Indice di un'operazione nei vettori di set_stats
+ *
+ * @param op operazione
+ * @return std::size_t indice
+ */
+inline constexpr std::size_t set_op_index(set_op op) {
+  return static_cast<std::size_t>(op);
+}
+
+/**
+ * @brief Policy di instrumentation che conta allocazioni, confronti e tempi
+ *
+ * Ogni thread ha i propri contatori: stats() ritorna quelli del thread
+ * corrente, total() la somma di tutti i thread (anche quelli già terminati),
+ * quindi si può leggere un totale del processo senza sincronizzare i thread
+ * che usano i set. reset() azzera i contatori del thread corrente.
+ *
+ * calls conta solo le chiamate dell'utente. Le scansioni fatte all'interno
+ * di un'altra operazione (es. le ricerche di operator- o di intersect_all, le
+ * notifiche ad una FilterView durante una remove, i confronti di operator==)
+ * non sono chiamate: i nodi visitati vengono sommati a scanned e max_scan
+ * dell'operazione esterna (find per operator==).
+ */
+struct counting_instrumentation {
+  /**
+   * @brief Token di start(), istante di inizio dell'operazione
+   */
+  class timer {
+   public:
+    timer() : _start(std::chrono::steady_clock::now()) {
+      _local().depth++;
+    }
+
+    ~timer() {
+      _local().leave();
+    }
+
+    timer(const timer&) = delete;
+    timer& operator=(const timer&) = delete;
+
+   private:
+    friend struct counting_instrumentation;
+
+    std::chrono::steady_clock::time_point _start;
+  };
+
+  /**
+   * @brief Guardia del lavoro interno di Set: le scansioni fatte nel
+   * frattempo vengono sommate all'operazione op
+   */
+  class internal {
+   public:
+    explicit internal(set_op op) : _op(op) {
+      _local().depth++;
+    }
+
+    ~internal() {
+      thread_counters& c = _local();
+      if (c.depth == 1) c.flush(_op);
+      c.leave();
+    }
+
+    internal(const internal&) = delete;
+    internal& operator=(const internal&) = delete;
+
+   private:
+    set_op _op;
+  };
+
+  /**
+   * @brief Contatori del thread corrente
+   *
+   * @return set_stats copia dei contatori
+   */
+  static set_stats stats() {
+    set_stats s = {};
+    _local().add_to(s);
+    return s;
+  }
+
+  /**
+   * @brief Contatori di tutti i thread del processo
+   *
+   * i thread ancora attivi vengono letti mentre lavorano, quindi la somma
+   * può mancare delle operazioni in corso
+   *
+   * @return set_stats somma dei contatori
+   */
+  static set_stats total() {
+    registry& r = _registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    set_stats s = r.finished;
+    for (std::size_t i = 0; i < r.threads.size(); ++i) r.threads[i]->add_to(s);
+    return s;
+  }
+
+  /**
+   * @brief Azzera i contatori del thread corrente
+   */
+  static void reset() {
+    thread_counters& c = _local();
+    c.allocations.store(0, std::memory_order_relaxed);
+    c.allocated_bytes.store(0, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < set_stats::ops; ++i) {
+      c.calls[i].store(0, std::memory_order_relaxed);
+      c.scanned[i].store(0, std::memory_order_relaxed);
+      c.max_scan[i].store(0, std::memory_order_relaxed);
+      c.nanoseconds[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Allocazione di un nodo
+   *
+   * @param bytes dimensione allocata
+   */
+  static void allocation(std::size_t bytes) {
+    thread_counters& c = _local();
+    _add(c.allocations, 1);
+    _add(c.allocated_bytes, bytes);
+  }
+
+  /**
+   * @brief Fine di una scansione della lista
+   *
+   * @param op operazione che ha fatto la scansione
+   * @param length nodi visitati (= confronti Eql fatti)
+   */
+  static void scan(set_op op, std::size_t length) {
+    thread_counters& c = _local();
+    if (c.depth != 0) {
+      // scansione interna, viene contata dall'operazione esterna
+      c.pending += length;
+      if (length > c.pending_max) c.pending_max = length;
+      return;
+    }
+    std::size_t i = set_op_index(op);
+    _add(c.calls[i], 1);
+    _add(c.scanned[i], length);
+    _max(c.max_scan[i], length);
+  }
+
+  /**
+   * @brief Inizio di un'operazione misurata
+   *
+   * @return timer istante di inizio
+   */
+  static timer start() {
+    return timer();
+  }
+
+  /**
+   * @brief Fine di un'operazione misurata
+   *
+   * @param op operazione misurata
+   * @param t token ritornato da start()
+   */
+  static void stop(set_op op, const timer& t) {
+    thread_counters& c = _local();
+    std::size_t i = set_op_index(op);
+    _add(c.calls[i], 1);
+    _add(c.nanoseconds[i],
+         std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - t._start)
+             .count());
+    if (c.depth == 1) c.flush(op);
+  }
+
+  /**
+   * @brief Operazione su un elemento, non viene contata
+   */
+  template <typename K>
+  static void element(set_op, const void*, const K&) {}
+
+  /**
+   * @brief Operazione su interi set, già contata da stop()
+   */
+  static void bulk(set_op, const void*, const void*, const void*) {}
+
+ private:
+  typedef std::atomic<unsigned long long> counter;
+
+  /**
+   * @brief Contatori di un thread
+   *
+   * scritti solo dal proprio thread, ma atomici perché total() li legge da
+   * un altro thread
+   */
+  struct thread_counters {
+    thread_counters() : depth(0), pending(0), pending_max(0) {
+      allocations.store(0, std::memory_order_relaxed);
+      allocated_bytes.store(0, std::memory_order_relaxed);
+      for (std::size_t i = 0; i < set_stats::ops; ++i) {
+        calls[i].store(0, std::memory_order_relaxed);
+        scanned[i].store(0, std::memory_order_relaxed);
+        max_scan[i].store(0, std::memory_order_relaxed);
+        nanoseconds[i].store(0, std::memory_order_relaxed);
+      }
+      registry& r = _registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      r.threads.push_back(this);
+    }
+
+    // alla fine del thread i contatori restano nel totale del processo
+    ~thread_counters() {
+      registry& r = _registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      add_to(r.finished);
+      r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+    }
+
+    thread_counters(const thread_counters&) = delete;
+    thread_counters& operator=(const thread_counters&) = delete;
+
+    /**
+     * @brief Somma i contatori a s
+     */
+    void add_to(set_stats& s) const {
+      s.allocations += allocations.load(std::memory_order_relaxed);
+      s.allocated_bytes += allocated_bytes.load(std::memory_order_relaxed);
+      for (std::size_t i = 0; i < set_stats::ops; ++i) {
+        s.calls[i] += calls[i].load(std::memory_order_relaxed);
+        s.scanned[i] += scanned[i].load(std::memory_order_relaxed);
+        s.max_scan[i] = std::max(s.max_scan[i],
+                                 max_scan[i].load(std::memory_order_relaxed));
+        s.nanoseconds[i] += nanoseconds[i].load(std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @brief Somma le scansioni interne all'operazione esterna op
+     */
+    void flush(set_op op) {
+      std::size_t i = set_op_index(op);
+      _add(scanned[i], pending);
+      _max(max_scan[i], pending_max);
+      pending = pending_max = 0;
+    }
+
+    /**
+     * @brief Fine di un timer o di una guardia
+     *
+     * le scansioni non ancora sommate (es. operazione interrotta da
+     * un'eccezione prima di stop()) vengono scartate
+     */
+    void leave() {
+      if (--depth == 0) pending = pending_max = 0;
+    }
+
+    counter allocations;
+    counter allocated_bytes;
+    counter calls[set_stats::ops];
+    counter scanned[set_stats::ops];
+    counter max_scan[set_stats::ops];
+    counter nanoseconds[set_stats::ops];
+    // timer e guardie aperti
+    unsigned int depth;
+    // nodi visitati dalle scansioni interne non ancora sommati
+    unsigned long long pending;
+    // scansione interna più lunga non ancora sommata
+    unsigned long long pending_max;
+  };
+
+  /**
+   * @brief Contatori di tutti i thread
+   */
+  struct registry {
+    std::mutex mutex;
+    // thread attivi
+    std::vector<const thread_counters*> threads;
+    // somma dei thread terminati
+    set_stats finished = {};
+  };
+
+  /**
+   * @brief Registro del processo, costruito prima dei contatori dei thread
+   * (quindi distrutto dopo)
+   */
+  static registry& _registry() {
+    static registry r;
+    return r;
+  }
+
+  static thread_counters& _local() {
+    static thread_local thread_counters c;
+    return c;
+  }
+
+  // i contatori sono scritti solo dal proprio thread: basta load + store
+  static void _add(counter& c, unsigned long long value) {
+    c.store(c.load(std::memory_order_relaxed) + value,
+            std::memory_order_relaxed);
+  }
+
+  static void _max(counter& c, unsigned long long value) {
+    if (value > c.load(std::memory_order_relaxed)) {
+      c.store(value, std::memory_order_relaxed);
+    }
+  }
+};
+
+#endif  // INSTRUMENTATION_H
@@ -10,10 +10,275 @@
 #define SET_H
 
 #include <algorithm>  // std::swap
+#include <atomic>     // std::atomic
 #include <cassert>    // assert
 #include <cstddef>    // std::ptrdiff_t
-#include <iostream>   // std::cout (per debug)
-#include <iterator>   // std::forward_iterator_tag
+#include <iterator>   // std::forward_iterator_tag, std::iterator_traits
+#include <mutex>      // std::mutex, std::lock_guard
+#include <ostream>    // std::ostream
+#include <vector>     // std::vector
+
+/**
+ * @brief Sketch nullo, policy di default di Set
+ *
+ * Non mantiene nessuno sketch: tutte le operazioni sono vuote e vengono
+ * eliminate dal compilatore. Uno sketch alternativo (vedi sketch.h) deve
+ * fornire la stessa interfaccia.
+ */
+struct no_sketch {
+  /**
+   * @brief Aggiorna lo sketch con un nuovo elemento
+   */
+  template <typename T>
+  void add(const T&) {}
+
+  /**
+   * @brief Riporta lo sketch allo stato del set vuoto
+   */
+  void clear() {}
+};
+
+/**
+ * @brief Sketch di un Set e flag di validità
+ *
+ * Classe base privata di Set. Gli sketch non supportano la cancellazione,
+ * quindi dopo una remove lo sketch viene solo segnato come non valido e
+ * ricostruito una volta sola alla prima lettura: una serie di remove costa
+ * una sola ricostruzione. La ricostruzione avviene sotto un mutex, quindi
+ * anche più thread che leggono lo stesso set const vedono uno sketch valido
+ *
+ * @tparam Sketch sketch del set
+ */
+template <typename Sketch>
+class set_sketch_base {
+ protected:
+  set_sketch_base() : _sketch(), _stale(false) {}
+
+  /**
+   * @brief Parte da uno sketch già calcolato (es. quello del set copiato)
+   *
+   * @param sketch sketch valido degli elementi del set
+   */
+  explicit set_sketch_base(const Sketch& sketch)
+      : _sketch(sketch), _stale(false) {}
+
+  template <typename T>
+  void _sketch_add(const T& value) {
+    _sketch.add(value);
+  }
+
+  void _sketch_invalidate() {
+    _stale.store(true, std::memory_order_relaxed);
+  }
+
+  void _sketch_reset() {
+    _sketch.clear();
+    _stale.store(false, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Scambia lo sketch con quello di un altro set
+   *
+   * @param other set con cui scambiare lo sketch
+   */
+  void _sketch_swap(set_sketch_base& other) {
+    std::swap(_sketch, other._sketch);
+    bool stale = _stale.load(std::memory_order_relaxed);
+    _stale.store(other._stale.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+    other._stale.store(stale, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Sketch aggiornato, ricostruito qui se non valido
+   *
+   * @param b iteratore al primo elemento del set
+   * @param e iteratore alla fine del set
+   */
+  template <typename Iter>
+  const Sketch& _sketch_value(Iter b, Iter e) const {
+    if (_stale.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_stale.load(std::memory_order_relaxed)) {
+        _sketch.clear();
+        for (; b != e; ++b) _sketch.add(*b);
+        _stale.store(false, std::memory_order_release);
+      }
+    }
+    return _sketch;
+  }
+
+ private:
+  // sketch probabilistico, ricostruito anche da un set const
+  mutable Sketch _sketch;
+  // true se c'è stata una remove dopo l'ultima ricostruzione dello sketch
+  mutable std::atomic<bool> _stale;
+  // serializza la ricostruzione tra più lettori
+  mutable std::mutex _mutex;
+};
+
+/**
+ * @brief Nessuno sketch: classe vuota, quindi grazie alla empty base
+ * optimization Set non diventa più grande
+ */
+template <>
+class set_sketch_base<no_sketch> {
+ protected:
+  set_sketch_base() {}
+
+  explicit set_sketch_base(const no_sketch&) {}
+
+  template <typename T>
+  void _sketch_add(const T&) {}
+
+  void _sketch_invalidate() {}
+
+  void _sketch_reset() {}
+
+  void _sketch_swap(set_sketch_base&) {}
+
+  template <typename Iter>
+  const no_sketch& _sketch_value(Iter, Iter) const {
+    static const no_sketch sketch = no_sketch();
+    return sketch;
+  }
+};
+
+/**
+ * @brief Operazioni di Set misurate dalle policy di instrumentation
+ */
+enum class set_op {
+  add,        // add (scansione per il duplicato)
+  remove,     // remove (scansione per l'elemento)
+  find,       // contains e ricerche interne (probe)
+  unite,      // operator+ e union_all
+  intersect,  // operator- e intersect_all
+  filter,     // filter_out
+  copy,       // copy constructor e copy assignment
+  clear,      // clear
+  destroy,    // distruttore
+  count       // numero di operazioni, non è un'operazione
+};
+
+/**
+ * @brief Instrumentation nulla, policy di default di Set
+ *
+ * Tutte le funzioni sono vuote e vengono eliminate dal compilatore, quindi
+ * non c'è nessun costo. Una policy alternativa (vedi instrumentation.h) deve
+ * fornire le stesse funzioni statiche.
+ */
+struct no_instrumentation {
+  // token ritornato da start(), vuoto
+  struct timer {};
+
+  // guardia aperta da Set per tutta la durata del lavoro interno (es. le
+  // notifiche agli osservatori), che non è un'operazione dell'utente ma fa
+  // parte dell'operazione op
+  struct internal {
+    explicit internal(set_op) {}
+  };
+
+  /**
+   * @brief Allocazione di un nodo
+   *
+   * @param bytes dimensione allocata
+   */
+  static void allocation(std::size_t) {}
+
+  /**
+   * @brief Fine di una scansione della lista
+   *
+   * @param op operazione che ha fatto la scansione
+   * @param length nodi visitati (= confronti Eql fatti)
+   */
+  static void scan(set_op, std::size_t) {}
+
+  /**
+   * @brief Inizio di un'operazione misurata
+   *
+   * @return timer token da passare a stop()
+   */
+  static timer start() {
+    return timer();
+  }
+
+  /**
+   * @brief Fine di un'operazione misurata
+   *
+   * @param op operazione misurata
+   * @param t token ritornato da start()
+   */
+  static void stop(set_op, const timer&) {}
+
+  /**
+   * @brief Operazione su un elemento (add, remove, find)
+   *
+   * chiamata solo dalle funzioni pubbliche, non dalle ricerche interne
+   *
+   * @param op operazione
+   * @param set set su cui viene fatta l'operazione
+   * @param key elemento o chiave eterogenea
+   */
+  template <typename K>
+  static void element(set_op, const void*, const K&) {}
+
+  /**
+   * @brief Operazione su interi set
+   *
+   * unite, intersect, filter e copy vengono chiamate dopo stop(), mentre il
+   * timer è ancora vivo; clear e destroy non hanno timer
+   *
+   * @param op operazione
+   * @param result set risultato (o set su cui viene fatta clear/destroy)
+   * @param a primo operando (nullptr se non c'è)
+   * @param b secondo operando (nullptr se non c'è)
+   */
+  static void bulk(set_op, const void*, const void*, const void*) {}
+};
+
+/**
+ * @brief Interfaccia per ricevere le modifiche di un Set
+ *
+ * Un osservatore registrato con Set::subscribe viene notificato per ogni
+ * elemento aggiunto, prima di ogni elemento rimosso e ad ogni clear. Usato
+ * dalle viste incrementali (vedi filter_view.h).
+ *
+ * on_add viene chiamata prima che l'elemento sia collegato: se lancia
+ * un'eccezione l'aggiunta viene annullata (gli osservatori già avvisati
+ * ricevono on_remove) e l'eccezione arriva al chiamante. on_remove, on_clear
+ * e on_detach non devono lanciare eccezioni.
+ *
+ * @tparam T tipo dei valori contenuti nel set
+ */
+template <typename T>
+class SetObserver {
+ public:
+  virtual ~SetObserver() {}
+
+  /**
+   * @brief Un elemento sta per essere aggiunto al set
+   *
+   * @param value elemento aggiunto
+   */
+  virtual void on_add(const T& value) = 0;
+
+  /**
+   * @brief Un elemento sta per essere rimosso dal set
+   *
+   * @param value elemento rimosso
+   */
+  virtual void on_remove(const T& value) = 0;
+
+  /**
+   * @brief Il set è stato svuotato
+   */
+  virtual void on_clear() = 0;
+
+  /**
+   * @brief Il set è stato distrutto, l'osservatore non è più registrato
+   */
+  virtual void on_detach() = 0;
+};
 
 /**
  * @brief Implementation of an unordered Set
@@ -23,10 +288,17 @@
  * generici T
  *
  * @tparam T tipo dei valori contenuti nel set
- * @tparam Eql operatore di confronto == (equivalenza) tra due tipi nel set
+ * @tparam Eql operatore di confronto == (equivalenza) tra due tipi nel set.
+ * Se definisce il tipo is_transparent, add, remove e contains accettano anche
+ * chiavi di tipo K diverso da T, purché Eql sia invocabile come Eql(T, K)
+ * @tparam Sketch sketch probabilistico aggiornato ad ogni add (di default
+ * no_sketch, nessun costo)
+ * @tparam Instr policy di instrumentation (di default no_instrumentation,
+ * nessun costo)
  */
-template <typename T, typename Eql>
-class Set {
+template <typename T, typename Eql, typename Sketch = no_sketch,
+          typename Instr = no_instrumentation>
+class Set : private set_sketch_base<Sketch> {
  public:
   // Macro per un unsigned int
   typedef unsigned int u_int;
@@ -39,11 +311,7 @@ class Set {
    *
    * Creazione di un Set vuoto (0 elementi)
    */
-  Set() : _head_set(nullptr), _cardinality(0) {
-#ifndef NDEBUG
-    std::cout << "Set()" << std::endl;
-#endif
-  }
+  Set() : _head_set(nullptr), _cardinality(0), _observers(nullptr) {}
 
   /**
    * @brief Copy constructor
@@ -51,26 +319,18 @@ class Set {
    * Copy contructor che effettua una deep copy da un Set
    *
    * @param other
-   * @throws std::bad_alloc possibile eccezione di allocazione dato che la add
-   * contiene una new
+   * @throws std::bad_alloc possibile eccezione di allocazione dato che la
+   * _append contiene una new
    */
-  Set(const Set& other) : _head_set(nullptr), _cardinality(0) {
-    node* current = other._head_set;
-    try {
-      while (current != nullptr) {
-        add(current->node_value);
-        current = current->next;
-      }
-      // la cardinalità viene impostata dalla add
-    } catch (...) {
-      // viene sempre fatta questa clear + eccezione quando c'è un add
-      clear();
-      throw;
-    }
-
-#ifndef NDEBUG
-    std::cout << "Set(const Set&)" << std::endl;
-#endif
+  Set(const Set& other)
+      : sketch_base(other.sketch()),
+        _head_set(nullptr),
+        _cardinality(0),
+        _observers(nullptr) {
+    typename Instr::timer t = Instr::start();
+    _copy_nodes(other);
+    Instr::stop(set_op::copy, t);
+    Instr::bulk(set_op::copy, this, &other, nullptr);
   }
 
   /**
@@ -84,26 +344,36 @@ class Set {
    */
   Set& operator=(const Set& other) {
     if (this != &other) {
-      Set tmp(other);
+      typename Instr::timer t = Instr::start();
+      Set tmp(other, untimed());
+      // gli osservatori restano di this e vedono il nuovo contenuto prima
+      // dello scambio: se falliscono il set resta com'era
+      _notify_assign(tmp._head_set);
       std::swap(this->_head_set, tmp._head_set);
       std::swap(this->_cardinality, tmp._cardinality);
+      this->_sketch_swap(tmp);
+      Instr::stop(set_op::copy, t);
+      Instr::bulk(set_op::copy, this, &other, nullptr);
     }
     return *this;
-#ifndef NDEBUG
-    std::cout << "Set& operator=(const Set&)" << std::endl;
-#endif
   }
 
   /**
    * @brief Distruttore di un oggetto Set
    *
-   * Viene distrutto l'oggetto Set sfruttando la funzione clear()
+   * Vengono liberati i nodi senza passare da clear(), che per Instr è
+   * un'operazione dell'utente; gli osservatori ancora registrati vengono
+   * staccati con on_detach() (quindi non ricevono la on_clear)
    */
   ~Set() {
-    clear();
-#ifndef NDEBUG
-    std::cout << "~Set()" << std::endl;
-#endif
+    if (_observers != nullptr) {
+      for (std::size_t i = 0; i < _observers->size(); ++i) {
+        (*_observers)[i]->on_detach();
+      }
+      delete _observers;
+    }
+    _free_nodes();
+    Instr::bulk(set_op::destroy, this, nullptr, nullptr);
   }
 
   /**
@@ -118,11 +388,14 @@ class Set {
    * contiene una new
    */
   template <typename Iter>
-  Set(Iter begin, Iter end) : _head_set(nullptr), _cardinality(0) {
+  Set(Iter begin, Iter end)
+      : _head_set(nullptr), _cardinality(0), _observers(nullptr) {
     try {
       for (; begin != end; ++begin) add(static_cast<T>(*begin));
     } catch (...) {
-      clear();
+      // il distruttore non viene chiamato
+      _free_nodes();
+      Instr::bulk(set_op::destroy, this, nullptr, nullptr);
       throw;
     }
   }
@@ -160,46 +433,27 @@ class Set {
    * un duplicato
    */
   bool add(const value_type& toadd) {
-    node* current = _head_set;
-
-    // caso set vuoto
-    if (this->is_empty()) {
-      node* tmp = new node(toadd);
-      _head_set = tmp;
-      _cardinality++;
-#ifndef NDEBUG
-      std::cout << "add(const value_type&)"
-                << " added first value " << toadd << std::endl;
-#endif
-      return true;
-    }
+    return _add(toadd);
+  }
 
-    // caso set popolato lo aggiungiamo alla fine
-    while (current != nullptr) {
-      // caso elemento duplicato
-      if (_equals(current->node_value, toadd)) {
-        // non aggiungiamo l'elemento (non creiamo neanche il nodo)
-#ifndef NDEBUG
-        std::cout << "add(const value_type&)"
-                  << " value already exists " << toadd << std::endl;
-#endif
-        return false;
-      }
-      // caso raggiunta fine della lista
-      if (current->next == nullptr) {
-        // siamo alla fine quindi aggiungiamo
-        node* tmp = new node(toadd);
-        current->next = tmp;
-        _cardinality++;
-#ifndef NDEBUG
-        std::cout << "add(const value_type&)"
-                  << " added value " << toadd << std::endl;
-#endif
-        return true;
-      }
-      // incremento
-      current = current->next;
-    }
+  /**
+   * @brief Aggiunge un elemento a partire da una chiave eterogenea
+   *
+   * Disponibile solo se Eql definisce is_transparent. La ricerca del
+   * duplicato avviene confrontando direttamente la chiave con gli elementi
+   * del set; un value_type viene costruito (da toadd) solo se l'inserimento
+   * ha successo
+   *
+   * @tparam K tipo della chiave, confrontabile con T tramite Eql
+   * @param toadd chiave da cui costruire l'elemento da aggiungere
+   * @return true sse item aggiunto con successo, false se è stato trovato
+   * un duplicato
+   * @throws std::bad_alloc possibile eccezione di allocazione dato che
+   * contiene una new
+   */
+  template <typename K, typename E = Eql, typename = typename E::is_transparent>
+  bool add(const K& toadd) {
+    return _add(toadd);
   }
 
   /**
@@ -210,42 +464,50 @@ class Set {
    * @param toremove elemento da rimuovre
    */
   void remove(const value_type& toremove) {
-    node* current = _head_set;
-    node* previous = _head_set;
+    _remove(toremove);
+  }
 
-    while (current != nullptr) {
-      // caso elemento da rimuovere trovato
-      if (_equals(current->node_value, toremove)) {
-        // caso inizio lista
-        if (current == previous) {
-          _head_set = current->next;
-          delete current;
-          _cardinality--;
-#ifndef NDEBUG
-          std::cout << "remove(const value_type&)"
-                    << " removed value at start " << toremove << std::endl;
-#endif
-          return;
-        } else {
-          // caso generico
-          previous->next = current->next;
-          delete current;
-          _cardinality--;
-#ifndef NDEBUG
-          std::cout << "remove(const value_type&)"
-                    << " removed value in the middle " << toremove << std::endl;
-#endif
-          return;
-        }
-      }
-      // incremento
-      previous = current;
-      current = current->next;
-    }
-#ifndef NDEBUG
-    std::cout << "remove(const value_type&) "
-              << " value not found " << toremove << std::endl;
-#endif
+  /**
+   * @brief Rimuove un elemento dal set tramite una chiave eterogenea
+   *
+   * Disponibile solo se Eql definisce is_transparent, non viene costruito
+   * nessun value_type temporaneo
+   *
+   * @tparam K tipo della chiave, confrontabile con T tramite Eql
+   * @param toremove chiave dell'elemento da rimuovere
+   */
+  template <typename K, typename E = Eql, typename = typename E::is_transparent>
+  void remove(const K& toremove) {
+    _remove(toremove);
+  }
+
+  /**
+   * @brief Controlla se un elemento è presente nel set
+   *
+   * @param tofind elemento da cercare
+   * @return true se l'elemento è presente
+   * @return false altrimenti
+   */
+  bool contains(const value_type& tofind) const {
+    Instr::element(set_op::find, this, tofind);
+    return _find(tofind) != nullptr;
+  }
+
+  /**
+   * @brief Controlla se un elemento è presente tramite una chiave eterogenea
+   *
+   * Disponibile solo se Eql definisce is_transparent, non viene costruito
+   * nessun value_type temporaneo
+   *
+   * @tparam K tipo della chiave, confrontabile con T tramite Eql
+   * @param tofind chiave da cercare
+   * @return true se l'elemento è presente
+   * @return false altrimenti
+   */
+  template <typename K, typename E = Eql, typename = typename E::is_transparent>
+  bool contains(const K& tofind) const {
+    Instr::element(set_op::find, this, tofind);
+    return _find(tofind) != nullptr;
   }
 
   /**
@@ -255,23 +517,66 @@ class Set {
    * @post _head_set == nullptr
    */
   void clear() {
-    node* current = _head_set;
-    while (current != nullptr) {
-      node* cnext = current->next;
-      delete current;
-      current = cnext;
+    Instr::bulk(set_op::clear, this, nullptr, nullptr);
+    _free_nodes();
+    this->_sketch_reset();
+    if (_observers == nullptr) return;
+    typename Instr::internal guard(set_op::clear);
+    for (std::size_t i = 0; i < _observers->size(); ++i) {
+      (*_observers)[i]->on_clear();
+    }
+  }
+
+  /**
+   * @brief Ritorna lo sketch del set
+   *
+   * dopo una remove lo sketch non è più valido (gli sketch non supportano la
+   * cancellazione), quindi viene ricostruito qui alla prima richiesta: una
+   * serie di remove costa una sola ricostruzione. Può essere chiamata da più
+   * thread sullo stesso set, purché nessuno lo modifichi
+   *
+   * @return const Sketch& sketch aggiornato con tutti gli elementi del set
+   */
+  const Sketch& sketch() const {
+    return this->_sketch_value(begin(), end());
+  }
+
+  /**
+   * @brief Registra un osservatore delle modifiche del set
+   *
+   * l'osservatore non viene copiato insieme al set e deve essere rimosso con
+   * unsubscribe prima di essere distrutto. La lista degli osservatori viene
+   * allocata qui alla prima registrazione: un set senza osservatori non la
+   * paga
+   *
+   * @param observer osservatore da registrare
+   * @throws std::bad_alloc possibile eccezione di allocazione
+   */
+  void subscribe(SetObserver<T>* observer) {
+    if (_observers == nullptr) _observers = new std::vector<SetObserver<T>*>();
+    _observers->push_back(observer);
+  }
+
+  /**
+   * @brief Rimuove un osservatore registrato con subscribe
+   *
+   * @param observer osservatore da rimuovere
+   */
+  void unsubscribe(SetObserver<T>* observer) {
+    if (_observers == nullptr) return;
+    _observers->erase(
+        std::remove(_observers->begin(), _observers->end(), observer),
+        _observers->end());
+    if (_observers->empty()) {
+      delete _observers;
+      _observers = nullptr;
     }
-    _cardinality = 0;
-    _head_set = nullptr;
-#ifndef NDEBUG
-    std::cout << "clear()"
-              << " set got cleared " << std::endl;
-#endif
   }
 
   // forward declarations per const iterator
  private:
   struct node;
+  typedef set_sketch_base<Sketch> sketch_base;
 
  public:
   /**
@@ -395,35 +700,24 @@ class Set {
    *
    * Vengono confrontati i due set e viene controllato se contengono gli
    * stessi elementi (NON viene contato l'ordine)
-   * la logica implementativa si basa sul costruire un altro set ed
-   * aggiungerci sia gli elementi di a che gli elementi di b e se il set
-   * risultante ha la stessa dimensione di a e b, allora a e b sono
-   * equivalenti
+   * gli elementi di un set sono distinti, quindi se i due set hanno la
+   * stessa dimensione basta cercare ogni elemento di other in questo set
+   * (con _find, così i confronti vengono riportati alla policy Instr come
+   * lavoro interno di find, non come chiamate dell'utente)
    *
-   * @param b secondo set
+   * @param other secondo set
    * @return true se i due set sono equivalenti
    * @return false altrimenti
-   * @throws std::bad_alloc possibile eccezione di allocazione dato che la add
-   * contiene una new
    */
-  bool operator==(const Set<T, Eql>& other) {
+  bool operator==(const Set& other) {
     // prima controllo parametri (dim)
     if (this->size() != other.size()) return false;
 
-    Eql predic;
-    const_iterator begin_a, end_a, begin_other, end_other;
-    for (begin_other = other.begin(), end_other = other.end();
-         begin_other != end_other; ++begin_other) {
-      // questa var found è una ottimizzazione per non far continuare
-      // il controllo dopo aver trovato un elemnto comune nel set b
-      for (begin_a = this->begin(), end_a = this->begin(); begin_a != end_a;
-           ++begin_a) {
-        if (!predic(*begin_a, *begin_other)) {
-          return false;
-        }
-      }
+    typename Instr::internal guard(set_op::find);
+    for (const node* current = other._head_set; current != nullptr;
+         current = current->next) {
+      if (_find(current->node_value) == nullptr) return false;
     }
-
     return true;
   }
 
@@ -454,12 +748,13 @@ class Set {
    *
    * @param a primo set
    * @param b secondo set
-   * @return Set<T, Eql> un nuovo set risultante da a unito b
+   * @return Set un nuovo set risultante da a unito b
    * @throws std::bad_alloc possibile eccezione di allocazione dato che la add
    * contiene una new
    */
-  friend Set<T, Eql> operator+(const Set<T, Eql>& a, const Set<T, Eql>& b) {
-    Set<T, Eql> tmp(a);
+  friend Set operator+(const Set& a, const Set& b) {
+    typename Instr::timer t = Instr::start();
+    Set tmp(a, untimed());
     try {
       node* current_b = b._head_set;
       while (current_b != nullptr) {
@@ -470,6 +765,8 @@ class Set {
       tmp.clear();
       throw;
     }
+    Instr::stop(set_op::unite, t);
+    Instr::bulk(set_op::unite, &tmp, &a, &b);
     return tmp;
   }
 
@@ -481,35 +778,71 @@ class Set {
    *
    * @param a primo set
    * @param b secondo set
-   * @return Set<T, Eql> un nuovo set risultante da a intersecato b
+   * @return Set un nuovo set risultante da a intersecato b
    * @throws std::bad_alloc possibile eccezione di allocazione dato che la add
    * contiene una new
    */
-  friend Set<T, Eql> operator-(const Set<T, Eql>& a, const Set<T, Eql>& b) {
-    Set<T, Eql> tmp;
+  friend Set operator-(const Set& a, const Set& b) {
+    typename Instr::timer t = Instr::start();
+    Set tmp;
     try {
-      Eql predic;
-      const_iterator begin_a, end_a, begin_b, end_b;
+      const_iterator begin_a, end_a;
       for (begin_a = a.begin(), end_a = a.end(); begin_a != end_a; ++begin_a) {
-        // questa var found è una ottimizzazione per non far continuare
-        // il controllo dopo aver trovato un elemnto comune nel set b
-        bool found = false;
-        for (begin_b = b.begin(), end_b = b.end(); (begin_b != end_b) && !found;
-             ++begin_b) {
-          if (predic(*begin_a, *begin_b)) {
-            found = true;
-            tmp.add(*begin_a);
-          }
-        }
+        // la ricerca in b si ferma al primo elemento equivalente
+        if (b._find(*begin_a) != nullptr) tmp.add(*begin_a);
       }
     } catch (...) {
       tmp.clear();
       throw;
     }
+    Instr::stop(set_op::intersect, t);
+    Instr::bulk(set_op::intersect, &tmp, &a, &b);
     return tmp;
   }
 
+  // vista incrementale, aggiunge in coda in O(1) con _append
+  template <typename U, typename E, typename S, typename I, typename P>
+  friend class FilterView;
+
+  // funzioni globali su più set, implementate dopo la classe
+  template <typename U, typename E, typename S, typename I, typename... Sets>
+  friend Set<U, E, S, I> intersect_all(const Set<U, E, S, I>& first,
+                                       const Sets&... others);
+
+  template <typename Iter>
+  friend typename std::iterator_traits<Iter>::value_type intersect_all(
+      Iter begin, Iter end);
+
+  template <typename U, typename E, typename S, typename I, typename... Sets>
+  friend Set<U, E, S, I> union_all(const Set<U, E, S, I>& first,
+                                   const Sets&... others);
+
+  template <typename Iter>
+  friend typename std::iterator_traits<Iter>::value_type union_all(Iter begin,
+                                                                   Iter end);
+
  private:
+  // tag del costruttore di copia interno
+  struct untimed {};
+
+  /**
+   * @brief Copia usata all'interno di un'altra operazione
+   *
+   * come il copy constructor, ma non viene riportata a Instr: il tempo e
+   * l'evento sono quelli dell'operazione esterna (es. operator+, che parte
+   * da una copia di a)
+   *
+   * @param other Set da copiare
+   * @throws std::bad_alloc possibile eccezione di allocazione
+   */
+  Set(const Set& other, untimed)
+      : sketch_base(other.sketch()),
+        _head_set(nullptr),
+        _cardinality(0),
+        _observers(nullptr) {
+    _copy_nodes(other);
+  }
+
   /**
    * @brief Struttura dati nodo
    *
@@ -543,6 +876,19 @@ class Set {
      */
     explicit node(const value_type& v) : node_value(v), next(nullptr) {}
 
+    /**
+     * @brief Costruttore da chiave eterogenea
+     *
+     * l'elemento viene costruito direttamente dalla chiave, senza passare
+     * da un value_type temporaneo
+     *
+     * @tparam K tipo della chiave
+     * @param k chiave da cui costruire l'elemento
+     * @post next == nullptr
+     */
+    template <typename K>
+    explicit node(const K& k) : node_value(k), next(nullptr) {}
+
     // Copy constructor, Operatore Assignment e Destructor possiamo
     // farli generare al compilatore
 
@@ -552,12 +898,420 @@ class Set {
     node* next;
   };
 
+  /**
+   * @brief Cerca il nodo che contiene un elemento equivalente alla chiave
+   *
+   * @tparam K tipo della chiave (value_type o chiave eterogenea)
+   * @param key chiave da cercare
+   * @return const node* nodo trovato, nullptr se non presente
+   */
+  template <typename K>
+  const node* _find(const K& key) const {
+    Eql predic;
+    const node* current = _head_set;
+    std::size_t length = 0;
+    while (current != nullptr) {
+      length++;
+      if (predic(current->node_value, key)) break;
+      current = current->next;
+    }
+    Instr::scan(set_op::find, length);
+    return current;
+  }
+
+  /**
+   * @brief Implementazione di add, condivisa con l'overload eterogeneo
+   *
+   * l'elemento viene aggiunto alla fine della lista solo se non è stato
+   * trovato un duplicato, quindi il nodo (e il value_type) viene costruito
+   * solo in caso di successo
+   *
+   * @tparam K tipo della chiave (value_type o chiave eterogenea)
+   * @param toadd elemento da aggiungere
+   * @return true sse item aggiunto con successo
+   */
+  template <typename K>
+  bool _add(const K& toadd) {
+    Instr::element(set_op::add, this, toadd);
+    node* current = _head_set;
+
+    // caso set vuoto
+    if (this->is_empty()) {
+      Instr::scan(set_op::add, 0);
+      node* tmp = _new_node(toadd);
+      _head_set = tmp;
+      _cardinality++;
+      this->_sketch_add(tmp->node_value);
+      return true;
+    }
+
+    // caso set popolato lo aggiungiamo alla fine
+    std::size_t length = 0;
+    while (true) {
+      length++;
+      // caso elemento duplicato
+      if (_equals(current->node_value, toadd)) {
+        // non aggiungiamo l'elemento (non creiamo neanche il nodo)
+        Instr::scan(set_op::add, length);
+        return false;
+      }
+      // caso raggiunta fine della lista
+      if (current->next == nullptr) {
+        Instr::scan(set_op::add, length);
+        // siamo alla fine quindi aggiungiamo
+        node* tmp = _new_node(toadd);
+        current->next = tmp;
+        _cardinality++;
+        this->_sketch_add(tmp->node_value);
+        return true;
+      }
+      // incremento
+      current = current->next;
+    }
+  }
+
+  /**
+   * @brief Copia in questo set (vuoto) i nodi di other
+   *
+   * gli elementi di other sono già distinti, quindi non serve il controllo
+   * dei duplicati della add; lo sketch è già quello di other. Se
+   * un'allocazione fallisce i nodi già copiati vengono liberati: il set non
+   * è ancora comparso in Instr, quindi non serve una clear
+   *
+   * @param other Set da copiare
+   * @throws std::bad_alloc possibile eccezione di allocazione
+   */
+  void _copy_nodes(const Set& other) {
+    node* tail = nullptr;
+    try {
+      for (const node* current = other._head_set; current != nullptr;
+           current = current->next) {
+        _link(current->node_value, tail);
+      }
+    } catch (...) {
+      _free_nodes();
+      throw;
+    }
+  }
+
+  /**
+   * @brief Libera tutti i nodi, senza avvisare Instr né gli osservatori
+   *
+   * @post _cardinality == 0
+   * @post _head_set == nullptr
+   */
+  void _free_nodes() {
+    node* current = _head_set;
+    while (current != nullptr) {
+      node* cnext = current->next;
+      delete current;
+      current = cnext;
+    }
+    _cardinality = 0;
+    _head_set = nullptr;
+  }
+
+  /**
+   * @brief Crea il nodo di un nuovo elemento e avvisa gli osservatori
+   *
+   * il nodo non è ancora collegato alla lista: se l'allocazione o un
+   * osservatore lanciano un'eccezione il set resta invariato
+   *
+   * @tparam K tipo della chiave (value_type o chiave eterogenea)
+   * @param toadd elemento da aggiungere
+   * @return node* nodo da collegare
+   * @throws std::bad_alloc possibile eccezione di allocazione
+   */
+  template <typename K>
+  node* _new_node(const K& toadd) {
+    node* tmp = new node(toadd);
+    Instr::allocation(sizeof(node));
+    try {
+      _notify_add(tmp->node_value);
+    } catch (...) {
+      delete tmp;
+      throw;
+    }
+    return tmp;
+  }
+
+  /**
+   * @brief Avvisa gli osservatori di un elemento che sta per essere aggiunto
+   *
+   * se un osservatore lancia un'eccezione quelli già avvisati ricevono
+   * on_remove, così tornano allo stato precedente
+   *
+   * @param value elemento aggiunto
+   */
+  void _notify_add(const value_type& value) {
+    if (_observers == nullptr) return;
+    typename Instr::internal guard(set_op::add);
+    std::vector<SetObserver<T>*>& observers = *_observers;
+    std::size_t i = 0;
+    try {
+      for (; i < observers.size(); ++i) observers[i]->on_add(value);
+    } catch (...) {
+      while (i > 0) observers[--i]->on_remove(value);
+      throw;
+    }
+  }
+
+  /**
+   * @brief Avvisa gli osservatori che il contenuto sta per essere sostituito
+   *
+   * ogni osservatore riceve on_clear e on_add per ogni nuovo elemento. Se
+   * uno lancia un'eccezione quelli già avvisati tornano al contenuto attuale;
+   * un osservatore che non riesce a tornare indietro viene staccato con
+   * on_detach, così non resta registrato con un contenuto diverso dal set
+   *
+   * @param head primo nodo del nuovo contenuto
+   */
+  void _notify_assign(const node* head) {
+    if (_observers == nullptr) return;
+    typename Instr::internal guard(set_op::copy);
+    std::vector<SetObserver<T>*>& observers = *_observers;
+    std::size_t i = 0;
+    try {
+      for (; i < observers.size(); ++i) _replay(observers[i], head);
+    } catch (...) {
+      for (std::size_t j = i + 1; j-- > 0;) {
+        try {
+          _replay(observers[j], _head_set);
+        } catch (...) {
+          observers[j]->on_detach();
+          observers.erase(observers.begin() + j);
+        }
+      }
+      throw;
+    }
+  }
+
+  /**
+   * @brief Porta un osservatore al contenuto che inizia da head
+   *
+   * @param observer osservatore
+   * @param head primo nodo del contenuto
+   */
+  static void _replay(SetObserver<T>* observer, const node* head) {
+    observer->on_clear();
+    for (const node* current = head; current != nullptr;
+         current = current->next) {
+      observer->on_add(current->node_value);
+    }
+  }
+
+  /**
+   * @brief Avvisa gli osservatori di un elemento che sta per essere rimosso
+   *
+   * @param value elemento rimosso
+   */
+  void _notify_remove(const value_type& value) {
+    if (_observers == nullptr) return;
+    typename Instr::internal guard(set_op::remove);
+    for (std::size_t i = 0; i < _observers->size(); ++i) {
+      (*_observers)[i]->on_remove(value);
+    }
+  }
+
+  /**
+   * @brief Aggiunge un elemento in coda senza controllare i duplicati
+   *
+   * da usare solo quando si sa già che l'elemento non è nel set (es. copia
+   * di un altro set), costa O(1) invece di O(n)
+   *
+   * @param toadd elemento da aggiungere
+   * @param tail ultimo nodo della lista (nullptr se vuota), viene aggiornato
+   * @throws std::bad_alloc possibile eccezione di allocazione
+   */
+  void _append(const value_type& toadd, node*& tail) {
+    _link(toadd, tail);
+    this->_sketch_add(tail->node_value);
+  }
+
+  /**
+   * @brief Come _append, ma senza aggiornare lo sketch
+   *
+   * usata dal copy constructor, che copia direttamente lo sketch dell'altro
+   * set invece di ricalcolarlo elemento per elemento
+   *
+   * @param toadd elemento da aggiungere
+   * @param tail ultimo nodo della lista (nullptr se vuota), viene aggiornato
+   * @throws std::bad_alloc possibile eccezione di allocazione
+   */
+  void _link(const value_type& toadd, node*& tail) {
+    node* tmp = _new_node(toadd);
+    if (tail == nullptr) {
+      _head_set = tmp;
+    } else {
+      tail->next = tmp;
+    }
+    tail = tmp;
+    _cardinality++;
+  }
+
+  /**
+   * @brief Intersezione di n set in una sola passata
+   *
+   * i set vengono ordinati per dimensione: gli elementi del più piccolo
+   * vengono cercati negli altri, dal più piccolo al più grande, e la ricerca
+   * si ferma al primo set che non li contiene. Se un set è vuoto il
+   * risultato è vuoto senza fare nessuna ricerca
+   *
+   * @param sets puntatori ai set da intersecare
+   * @return Set l'intersezione di tutti i set
+   * @throws std::bad_alloc possibile eccezione di allocazione
+   */
+  static Set _intersect(std::vector<const Set*> sets) {
+    typename Instr::timer t = Instr::start();
+    Set tmp;
+    if (sets.empty()) {
+      Instr::stop(set_op::intersect, t);
+      return tmp;
+    }
+
+    std::sort(sets.begin(), sets.end(), [](const Set* a, const Set* b) {
+      return a->size() < b->size();
+    });
+    if (sets.front()->is_empty()) {
+      Instr::stop(set_op::intersect, t);
+      _bulk_all(set_op::intersect, tmp, sets);
+      return tmp;
+    }
+
+    node* tail = nullptr;
+    try {
+      for (const node* current = sets.front()->_head_set; current != nullptr;
+           current = current->next) {
+        bool found = true;
+        for (std::size_t i = 1; i < sets.size() && found; ++i) {
+          found = (sets[i]->_find(current->node_value) != nullptr);
+        }
+        // gli elementi del set più piccolo sono già distinti
+        if (found) tmp._append(current->node_value, tail);
+      }
+    } catch (...) {
+      tmp.clear();
+      throw;
+    }
+    Instr::stop(set_op::intersect, t);
+    _bulk_all(set_op::intersect, tmp, sets);
+    return tmp;
+  }
+
+  /**
+   * @brief Unione di n set in una sola passata
+   *
+   * il risultato parte dalla copia (lineare) del set più grande e poi vengono
+   * aggiunti gli elementi degli altri, senza set intermedi
+   *
+   * @param sets puntatori ai set da unire
+   * @return Set l'unione di tutti i set
+   * @throws std::bad_alloc possibile eccezione di allocazione
+   */
+  static Set _union(const std::vector<const Set*>& sets) {
+    typename Instr::timer t = Instr::start();
+    std::size_t largest = 0;
+    for (std::size_t i = 1; i < sets.size(); ++i) {
+      if (sets[i]->size() > sets[largest]->size()) largest = i;
+    }
+
+    // un solo set risultato, così il return non passa dal copy constructor
+    Set tmp(sets.empty() ? Set() : Set(*sets[largest], untimed()));
+    if (sets.empty()) {
+      Instr::stop(set_op::unite, t);
+      return tmp;
+    }
+    try {
+      for (std::size_t i = 0; i < sets.size(); ++i) {
+        if (i == largest) continue;
+        for (const node* current = sets[i]->_head_set; current != nullptr;
+             current = current->next) {
+          tmp.add(current->node_value);
+        }
+      }
+    } catch (...) {
+      tmp.clear();
+      throw;
+    }
+    Instr::stop(set_op::unite, t);
+    _bulk_all(set_op::unite, tmp, sets);
+    return tmp;
+  }
+
+  /**
+   * @brief Operazione su n set come sequenza di operazioni binarie
+   *
+   * Instr::bulk ha al massimo due operandi, quindi result = s0 op s1 ... op
+   * sn viene riportata come una copy seguita da n - 1 operazioni
+   *
+   * @param op operazione (unite o intersect)
+   * @param result set risultato
+   * @param sets operandi
+   */
+  static void _bulk_all(set_op op, const Set& result,
+                        const std::vector<const Set*>& sets) {
+    Instr::bulk(set_op::copy, &result, sets.front(), nullptr);
+    for (std::size_t i = 1; i < sets.size(); ++i) {
+      Instr::bulk(op, &result, &result, sets[i]);
+    }
+  }
+
+  /**
+   * @brief Implementazione di remove, condivisa con l'overload eterogeneo
+   *
+   * @tparam K tipo della chiave (value_type o chiave eterogenea)
+   * @param toremove elemento da rimuovere
+   * @param tail se non nullptr, puntatore all'ultimo nodo mantenuto dal
+   * chiamante: viene aggiornato nella stessa scansione se viene rimosso
+   */
+  template <typename K>
+  void _remove(const K& toremove, node** tail = nullptr) {
+    Instr::element(set_op::remove, this, toremove);
+    node* current = _head_set;
+    node* previous = _head_set;
+    std::size_t length = 0;
+
+    while (current != nullptr) {
+      length++;
+      // caso elemento da rimuovere trovato
+      if (_equals(current->node_value, toremove)) {
+        Instr::scan(set_op::remove, length);
+        // caso inizio lista
+        if (current == previous) {
+          _notify_remove(current->node_value);
+          _head_set = current->next;
+          if (tail != nullptr && *tail == current) *tail = nullptr;
+          delete current;
+          _cardinality--;
+          this->_sketch_invalidate();
+          return;
+        } else {
+          // caso generico
+          _notify_remove(current->node_value);
+          previous->next = current->next;
+          if (tail != nullptr && *tail == current) *tail = previous;
+          delete current;
+          _cardinality--;
+          this->_sketch_invalidate();
+          return;
+        }
+      }
+      // incremento
+      previous = current;
+      current = current->next;
+    }
+    Instr::scan(set_op::remove, length);
+  }
+
   // Linked list for set
   node* _head_set;
   // Set size (cardinality)
   u_int _cardinality;
   // equals operator for ==
   Eql _equals;
+  // osservatori registrati (es. FilterView), non vengono copiati; nullptr
+  // finché non viene registrato il primo
+  std::vector<SetObserver<T>*>* _observers;
 };
 
 /**
@@ -566,19 +1320,24 @@ class Set {
  *
  * @tparam T tipo del set
  * @tparam Eql operatore di confronto del set
+ * @tparam Sketch sketch del set
+ * @tparam Instr policy di instrumentation del set
  * @tparam P predicato
  * @param S il set sui cui elementi viene verificata la corrispondenza
  * @param pred il predicato da applicare agli element del set
- * @return Set<T, Eql> un nuovo set che contiene tutti gli elementi di S che
- * soddisfano il prediato P
+ * @return Set<T, Eql, Sketch, Instr> un nuovo set che contiene tutti gli
+ * elementi di S che soddisfano il prediato P
  * @throws std::bad_alloc possibile eccezione di allocazione dato che la add
  * contiene una new
  */
-template <typename T, typename Eql, typename P>
-Set<T, Eql> filter_out(const Set<T, Eql>& S, P pred) {
-  Set<T, Eql> tmp;
+template <typename T, typename Eql, typename Sketch, typename Instr,
+          typename P>
+Set<T, Eql, Sketch, Instr> filter_out(const Set<T, Eql, Sketch, Instr>& S,
+                                      P pred) {
+  typename Instr::timer t = Instr::start();
+  Set<T, Eql, Sketch, Instr> tmp;
   try {
-    typename Set<T, Eql>::const_iterator b, e;
+    typename Set<T, Eql, Sketch, Instr>::const_iterator b, e;
     for (b = S.begin(), e = S.end(); b != e; ++b) {
       if (pred(*b)) tmp.add(*b);
     }
@@ -586,7 +1345,121 @@ Set<T, Eql> filter_out(const Set<T, Eql>& S, P pred) {
     tmp.clear();
     throw;
   }
+  Instr::stop(set_op::filter, t);
+  Instr::bulk(set_op::filter, &tmp, &S, nullptr);
   return tmp;
 }
 
+/**
+ * @brief Intersezione di più set in una sola passata
+ *
+ * a differenza di a - b - c non vengono costruiti set intermedi: si parte dal
+ * set più piccolo e ci si ferma appena un elemento manca in un set
+ *
+ * @tparam T tipo del set
+ * @tparam Eql operatore di confronto del set
+ * @tparam Sketch sketch del set
+ * @tparam Instr policy di instrumentation del set
+ * @tparam Sets altri set, dello stesso tipo del primo
+ * @param first primo set
+ * @param others altri set
+ * @return Set<T, Eql, Sketch, Instr> un nuovo set con gli elementi comuni a
+ * tutti
+ * @throws std::bad_alloc possibile eccezione di allocazione
+ */
+template <typename T, typename Eql, typename Sketch, typename Instr,
+          typename... Sets>
+Set<T, Eql, Sketch, Instr> intersect_all(
+    const Set<T, Eql, Sketch, Instr>& first, const Sets&... others) {
+  return Set<T, Eql, Sketch, Instr>::_intersect({&first, &others...});
+}
+
+/**
+ * @brief Intersezione di una sequenza di set in una sola passata
+ *
+ * @tparam Iter tipo dell'iteratore, deve ritornare dei Set
+ * @param begin iteratore di inizio
+ * @param end iteratore di fine
+ * @return un nuovo set con gli elementi comuni a tutti (vuoto se la sequenza
+ * è vuota)
+ * @throws std::bad_alloc possibile eccezione di allocazione
+ */
+template <typename Iter>
+typename std::iterator_traits<Iter>::value_type intersect_all(Iter begin,
+                                                              Iter end) {
+  typedef typename std::iterator_traits<Iter>::value_type set_type;
+  std::vector<const set_type*> sets;
+  for (; begin != end; ++begin) sets.push_back(&*begin);
+  return set_type::_intersect(sets);
+}
+
+/**
+ * @brief Intersezione di un range di set (es. std::vector di Set)
+ *
+ * @tparam Range tipo del range
+ * @param sets range di set
+ * @return un nuovo set con gli elementi comuni a tutti
+ * @throws std::bad_alloc possibile eccezione di allocazione
+ */
+template <typename Range>
+auto intersect_all(const Range& sets)
+    -> decltype(intersect_all(std::begin(sets), std::end(sets))) {
+  return intersect_all(std::begin(sets), std::end(sets));
+}
+
+/**
+ * @brief Unione di più set in una sola passata
+ *
+ * a differenza di a + b + c non vengono costruiti set intermedi
+ *
+ * @tparam T tipo del set
+ * @tparam Eql operatore di confronto del set
+ * @tparam Sketch sketch del set
+ * @tparam Instr policy di instrumentation del set
+ * @tparam Sets altri set, dello stesso tipo del primo
+ * @param first primo set
+ * @param others altri set
+ * @return Set<T, Eql, Sketch, Instr> un nuovo set con gli elementi di tutti
+ * i set
+ * @throws std::bad_alloc possibile eccezione di allocazione
+ */
+template <typename T, typename Eql, typename Sketch, typename Instr,
+          typename... Sets>
+Set<T, Eql, Sketch, Instr> union_all(
+    const Set<T, Eql, Sketch, Instr>& first, const Sets&... others) {
+  return Set<T, Eql, Sketch, Instr>::_union({&first, &others...});
+}
+
+/**
+ * @brief Unione di una sequenza di set in una sola passata
+ *
+ * @tparam Iter tipo dell'iteratore, deve ritornare dei Set
+ * @param begin iteratore di inizio
+ * @param end iteratore di fine
+ * @return un nuovo set con gli elementi di tutti i set
+ * @throws std::bad_alloc possibile eccezione di allocazione
+ */
+template <typename Iter>
+typename std::iterator_traits<Iter>::value_type union_all(Iter begin,
+                                                          Iter end) {
+  typedef typename std::iterator_traits<Iter>::value_type set_type;
+  std::vector<const set_type*> sets;
+  for (; begin != end; ++begin) sets.push_back(&*begin);
+  return set_type::_union(sets);
+}
+
+/**
+ * @brief Unione di un range di set (es. std::vector di Set)
+ *
+ * @tparam Range tipo del range
+ * @param sets range di set
+ * @return un nuovo set con gli elementi di tutti i set
+ * @throws std::bad_alloc possibile eccezione di allocazione
+ */
+template <typename Range>
+auto union_all(const Range& sets)
+    -> decltype(union_all(std::begin(sets), std::end(sets))) {
+  return union_all(std::begin(sets), std::end(sets));
+}
+
 #endif  // SET_H
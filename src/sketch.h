@@ -0,0 +1,192 @@
+/**
+ * @file sketch.h
+ * @author Nidal Guerouaja
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <array>    // std::array
+#include <cmath>    // std::log, std::ldexp
+#include <cstddef>  // std::size_t
+#include <cstdint>  // std::uint64_t, std::uint8_t
+#include <limits>   // std::numeric_limits
+
+#include "set.h"
+
+/**
+ * @brief Sketch MinHash + HyperLogLog per un Set
+ *
+ * Da usare come terzo parametro di Set: viene aggiornato ad ogni add, in
+ * O(K), e permette di stimare la similarità di Jaccard tra due set (MinHash)
+ * e la cardinalità dell'unione di più set (HyperLogLog) in O(dimensione
+ * dello sketch) invece di O(n*m).
+ *
+ * @tparam Hash funzione di hash per gli elementi del set
+ * @tparam K numero di funzioni di hash della firma MinHash (errore ~1/sqrt(K))
+ * @tparam P precisione HyperLogLog, 2^P registri (errore ~1.04/sqrt(2^P))
+ */
+template <typename Hash, std::size_t K = 128, unsigned int P = 12>
+class minhash_hll_sketch {
+  static_assert(K > 0, "la firma MinHash deve avere almeno un valore");
+  static_assert(P >= 4 && P <= 16, "precisione HyperLogLog non supportata");
+
+ public:
+  // numero di registri HyperLogLog
+  static constexpr std::size_t registers = std::size_t(1) << P;
+
+  /**
+   * @brief Costruttore di default, sketch di un set vuoto
+   */
+  minhash_hll_sketch() {
+    clear();
+  }
+
+  /**
+   * @brief Aggiorna lo sketch con un nuovo elemento
+   *
+   * @tparam T tipo dell'elemento
+   * @param value elemento aggiunto al set
+   */
+  template <typename T>
+  void add(const T& value) {
+    Hash hasher;
+    std::uint64_t h = _mix(static_cast<std::uint64_t>(hasher(value)));
+
+    for (std::size_t i = 0; i < K; ++i) {
+      std::uint64_t v = _mix(h ^ ((i + 1) * 0x9E3779B97F4A7C15ull));
+      if (v < _minhash[i]) _minhash[i] = v;
+    }
+
+    // i primi P bit scelgono il registro, il resto dà il rango
+    std::size_t index = static_cast<std::size_t>(h >> (64 - P));
+    std::uint64_t rest = (h << P) | (std::uint64_t(1) << (P - 1));
+    std::uint8_t rank = 1;
+    while ((rest & (std::uint64_t(1) << 63)) == 0) {
+      rest <<= 1;
+      rank++;
+    }
+    if (rank > _hll[index]) _hll[index] = rank;
+  }
+
+  /**
+   * @brief Riporta lo sketch allo stato del set vuoto
+   */
+  void clear() {
+    _minhash.fill(std::numeric_limits<std::uint64_t>::max());
+    _hll.fill(0);
+  }
+
+  /**
+   * @brief Unisce un altro sketch a questo (sketch dell'unione dei set)
+   *
+   * @param other sketch da unire
+   */
+  void merge(const minhash_hll_sketch& other) {
+    for (std::size_t i = 0; i < K; ++i) {
+      if (other._minhash[i] < _minhash[i]) _minhash[i] = other._minhash[i];
+    }
+    for (std::size_t i = 0; i < registers; ++i) {
+      if (other._hll[i] > _hll[i]) _hll[i] = other._hll[i];
+    }
+  }
+
+  /**
+   * @brief Stima della similarità di Jaccard tramite le firme MinHash
+   *
+   * @param other sketch dell'altro set
+   * @return double frazione dei valori della firma uguali, in [0, 1]
+   */
+  double jaccard(const minhash_hll_sketch& other) const {
+    std::size_t equal = 0;
+    for (std::size_t i = 0; i < K; ++i) {
+      if (_minhash[i] == other._minhash[i]) equal++;
+    }
+    return static_cast<double>(equal) / K;
+  }
+
+  /**
+   * @brief Stima della cardinalità tramite HyperLogLog
+   *
+   * per cardinalità piccole viene usato il linear counting
+   *
+   * @return double numero stimato di elementi distinti
+   */
+  double cardinality() const {
+    const double m = static_cast<double>(registers);
+    double sum = 0;
+    std::size_t zeros = 0;
+    for (std::size_t i = 0; i < registers; ++i) {
+      sum += std::ldexp(1.0, -_hll[i]);
+      if (_hll[i] == 0) zeros++;
+    }
+    double estimate = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros != 0) {
+      estimate = m * std::log(m / zeros);
+    }
+    return estimate;
+  }
+
+ private:
+  /**
+   * @brief Rimescola un hash (finalizzatore splitmix64)
+   *
+   * serve anche a distribuire bene hash deboli come std::hash<int>
+   */
+  static std::uint64_t _mix(std::uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+  }
+
+  // firma MinHash: minimo di ogni funzione di hash
+  std::array<std::uint64_t, K> _minhash;
+  // registri HyperLogLog
+  std::array<std::uint8_t, registers> _hll;
+};
+
+/**
+ * @brief Stima della similarità di Jaccard |a ∩ b| / |a ∪ b|
+ *
+ * dopo una remove su a o b lo sketch viene ricostruito solo alla prima
+ * chiamata, poi costa O(dimensione dello sketch)
+ *
+ * @tparam T tipo del set
+ * @tparam Eql operatore di confronto del set
+ * @tparam Sketch sketch del set (es. minhash_hll_sketch)
+ * @tparam Instr policy di instrumentation del set
+ * @param a primo set
+ * @param b secondo set
+ * @return double similarità stimata, in [0, 1]
+ */
+template <typename T, typename Eql, typename Sketch, typename Instr>
+double jaccard_estimate(const Set<T, Eql, Sketch, Instr>& a,
+                        const Set<T, Eql, Sketch, Instr>& b) {
+  return a.sketch().jaccard(b.sketch());
+}
+
+/**
+ * @brief Stima della cardinalità dell'unione di uno o più set
+ *
+ * @tparam T tipo del set
+ * @tparam Eql operatore di confronto del set
+ * @tparam Sketch sketch del set (es. minhash_hll_sketch)
+ * @tparam Instr policy di instrumentation del set
+ * @tparam Sets altri set, dello stesso tipo del primo
+ * @param first primo set
+ * @param others altri set
+ * @return double numero stimato di elementi distinti nell'unione
+ */
+template <typename T, typename Eql, typename Sketch, typename Instr,
+          typename... Sets>
+double union_cardinality_estimate(const Set<T, Eql, Sketch, Instr>& first,
+                                  const Sets&... others) {
+  Sketch merged(first.sketch());
+  (merged.merge(others.sketch()), ...);
+  return merged.cardinality();
+}
+
+#endif  // SKETCH_H
@@ -0,0 +1,390 @@
+/**
+ * @file static_set.h
+ * @author Nidal Guerouaja
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef STATIC_SET_H
+#define STATIC_SET_H
+
+#include <array>        // std::array
+#include <cstddef>      // std::size_t, std::ptrdiff_t
+#include <cstdint>      // std::uint64_t
+#include <iostream>     // std::ostream
+#include <stdexcept>    // std::logic_error
+#include <string_view>  // std::string_view
+#include <type_traits>  // std::enable_if, std::is_integral
+
+#include "set.h"
+
+/**
+ * @brief funtore di uguaglianza constexpr di default per StaticSet
+ *
+ * usa l'operatore == del tipo, è trasparente quindi permette anche il
+ * confronto con chiavi di tipo diverso (es. std::string_view e const char*)
+ */
+struct static_set_equal {
+  typedef void is_transparent;
+
+  template <typename A, typename B>
+  constexpr bool operator()(const A& a, const B& b) const {
+    return (a == b);
+  }
+};
+
+/**
+ * @brief funtore di hash constexpr di default per StaticSet
+ *
+ * supporta i tipi interi e le stringhe (tramite std::string_view, FNV-1a)
+ */
+struct static_set_hash {
+  typedef void is_transparent;
+
+  template <typename I, typename = typename std::enable_if<
+                            std::is_integral<I>::value>::type>
+  constexpr std::size_t operator()(I value) const {
+    return static_cast<std::size_t>(value);
+  }
+
+  constexpr std::size_t operator()(std::string_view value) const {
+    std::uint64_t h = 14695981039346656037ull;
+    for (char c : value) {
+      h ^= static_cast<unsigned char>(c);
+      h *= 1099511628211ull;
+    }
+    return static_cast<std::size_t>(h);
+  }
+};
+
+/**
+ * @brief Set immutabile costruito a compile time
+ *
+ * Classe StaticSet che rappresenta un set matematico di N elementi noti a
+ * compile time. Alla costruzione viene generato un hash perfetto minimo
+ * (algoritmo "hash and displace"): ogni elemento ha uno slot dedicato
+ * nell'array interno, quindi la ricerca costa un hash, un accesso e un
+ * confronto. Se dichiarato constexpr non ha costi di inizializzazione a
+ * runtime e finisce nei dati in sola lettura.
+ *
+ * La costruzione costa O(N) attesi (ogni bucket visita solo i suoi
+ * elementi). Con i limiti di default di GCC (-fconstexpr-ops-limit) un set
+ * constexpr arriva ad almeno 20000 stringhe; oltre bisogna alzare il limite
+ * del compilatore.
+ *
+ * @tparam T tipo dei valori contenuti nel set (deve essere un literal type,
+ * es. std::string_view al posto di std::string)
+ * @tparam N numero di elementi del set
+ * @tparam Eql operatore di confronto == (equivalenza) constexpr
+ * @tparam Hash funzione di hash constexpr, coerente con Eql
+ */
+template <typename T, std::size_t N, typename Eql = static_set_equal,
+          typename Hash = static_set_hash>
+class StaticSet {
+  static_assert(N > 0, "StaticSet deve contenere almeno un elemento");
+
+ public:
+  // Macro per un unsigned int
+  typedef unsigned int u_int;
+  // Macro per il valore generico T
+  typedef T value_type;
+  // gli elementi sono contigui quindi basta un puntatore come iteratore
+  typedef const T* const_iterator;
+
+  /**
+   * @brief Costruttore da una lista di elementi
+   *
+   * viene generato l'hash perfetto per gli elementi passati; se usato in un
+   * contesto constexpr un eventuale errore diventa un errore di compilazione
+   *
+   * @param elements elementi del set (es. {1, 2, 3})
+   * @throws std::logic_error se ci sono elementi duplicati o se due elementi
+   * diversi hanno lo stesso hash
+   */
+  constexpr explicit StaticSet(const T (&elements)[N])
+      : _elements{}, _displacements{} {
+    Hash hasher;
+    std::size_t hashes[N] = {};
+    std::size_t bucket_of[N] = {};
+    for (std::size_t i = 0; i < N; ++i) {
+      hashes[i] = hasher(elements[i]);
+      bucket_of[i] = _mix(hashes[i], 0) % N;
+    }
+
+    // counting sort per bucket: gli elementi del bucket b sono
+    // members[first[b]] ... members[first[b + 1] - 1]
+    std::size_t first[N + 1] = {};
+    std::size_t members[N] = {};
+    for (std::size_t i = 0; i < N; ++i) first[bucket_of[i] + 1]++;
+    for (std::size_t b = 0; b < N; ++b) first[b + 1] += first[b];
+    std::size_t fill[N] = {};
+    for (std::size_t i = 0; i < N; ++i) {
+      std::size_t b = bucket_of[i];
+      members[first[b] + fill[b]++] = i;
+    }
+
+    // elementi uguali hanno lo stesso hash quindi finiscono nello stesso
+    // bucket: basta confrontare gli elementi di ogni bucket tra loro
+    Eql predic;
+    for (std::size_t b = 0; b < N; ++b) {
+      for (std::size_t x = first[b]; x < first[b + 1]; ++x) {
+        for (std::size_t y = x + 1; y < first[b + 1]; ++y) {
+          std::size_t i = members[x], j = members[y];
+          if (predic(elements[i], elements[j])) {
+            throw std::logic_error("StaticSet: elementi duplicati");
+          }
+          if (hashes[i] == hashes[j]) {
+            throw std::logic_error("StaticSet: collisione di hash");
+          }
+        }
+      }
+    }
+
+    // i bucket più popolati vengono sistemati per primi (counting sort per
+    // dimensione, decrescente)
+    std::size_t by_size[N + 2] = {};
+    for (std::size_t b = 0; b < N; ++b) {
+      by_size[N - (first[b + 1] - first[b]) + 1]++;
+    }
+    for (std::size_t i = 0; i <= N; ++i) by_size[i + 1] += by_size[i];
+    std::size_t order[N] = {};
+    for (std::size_t b = 0; b < N; ++b) {
+      order[by_size[N - (first[b + 1] - first[b])]++] = b;
+    }
+
+    bool used[N] = {};
+    std::size_t slots[N] = {};
+    std::size_t k = 0;
+
+    // bucket con più elementi: si cerca un seed che li mandi in slot liberi
+    for (; k < N && first[order[k] + 1] - first[order[k]] > 1; ++k) {
+      std::size_t b = order[k];
+      std::ptrdiff_t seed = 1;
+      for (;; ++seed) {
+        if (seed > _max_seed) {
+          throw std::logic_error("StaticSet: collisione di hash");
+        }
+        std::size_t placed = 0;
+        bool ok = true;
+        for (std::size_t x = first[b]; x < first[b + 1] && ok; ++x) {
+          std::size_t s = _mix(hashes[members[x]], seed) % N;
+          // slot già occupato o usato da un altro elemento dello stesso bucket
+          for (std::size_t p = 0; p < placed && ok; ++p) {
+            if (slots[p] == s) ok = false;
+          }
+          if (used[s]) ok = false;
+          slots[placed++] = s;
+        }
+        if (ok) break;
+      }
+      for (std::size_t x = first[b]; x < first[b + 1]; ++x) {
+        std::size_t s = slots[x - first[b]];
+        used[s] = true;
+        _elements[s] = elements[members[x]];
+      }
+      _displacements[b] = seed;
+    }
+
+    // bucket con un solo elemento: lo slot libero viene salvato direttamente
+    std::size_t free_slot = 0;
+    for (; k < N && first[order[k] + 1] - first[order[k]] == 1; ++k) {
+      std::size_t b = order[k];
+      while (used[free_slot]) free_slot++;
+      _elements[free_slot] = elements[members[first[b]]];
+      used[free_slot] = true;
+      _displacements[b] = -static_cast<std::ptrdiff_t>(free_slot) - 1;
+    }
+  }
+
+  /**
+   * @brief Controlla se il set è vuoto
+   *
+   * @return false sempre, uno StaticSet ha almeno un elemento
+   */
+  constexpr bool is_empty() const {
+    return false;
+  }
+
+  /**
+   * @brief Dimensione del set
+   *
+   * @return u_int cardinalità del set (N)
+   */
+  constexpr u_int size() const {
+    return static_cast<u_int>(N);
+  }
+
+  /**
+   * @brief Controlla se un elemento è presente nel set
+   *
+   * un solo accesso all'array e un solo confronto
+   *
+   * @param tofind elemento da cercare
+   * @return true se l'elemento è presente
+   * @return false altrimenti
+   */
+  constexpr bool contains(const value_type& tofind) const {
+    return _contains(tofind);
+  }
+
+  /**
+   * @brief Controlla se un elemento è presente tramite una chiave eterogenea
+   *
+   * Disponibile solo se Eql definisce is_transparent, Hash deve essere
+   * invocabile con K e dare lo stesso risultato dell'elemento equivalente
+   *
+   * @tparam K tipo della chiave
+   * @param tofind chiave da cercare
+   * @return true se l'elemento è presente
+   * @return false altrimenti
+   */
+  template <typename K, typename E = Eql, typename = typename E::is_transparent>
+  constexpr bool contains(const K& tofind) const {
+    return _contains(tofind);
+  }
+
+  /**
+   * @brief Ritorna l'iteratore per l'inizio della sequenza di dati
+   *
+   * @return const_iterator iteratore al primo elemento
+   */
+  constexpr const_iterator begin() const {
+    return _elements.data();
+  }
+
+  /**
+   * @brief Ritorna l'iteratore per la fine della sequenza di dati
+   *
+   * @return const_iterator iteratore a uno dopo l'ultimo elemento
+   */
+  constexpr const_iterator end() const {
+    return _elements.data() + N;
+  }
+
+  /**
+   * @brief Overload operatore [] per accesso a dati del set tramite indice
+   *
+   * l'ordine è quello degli slot dell'hash perfetto, non quello di
+   * inserimento
+   *
+   * @param i indice "posizione" dell'elemento
+   * @return const value_type& const reference al dato del set in posizione i
+   */
+  constexpr const value_type& operator[](const int i) const {
+    assert(i >= 0);
+    assert(static_cast<std::size_t>(i) < N);
+    return _elements[i];
+  }
+
+  /**
+   * @brief overload operatore << per tutti gli elementi di un set
+   *
+   * vengono mandati tutti gli elementi di un set (separati da doppio spazio)
+   *
+   * @param os output stream
+   * @param set il set da mandare allo stream
+   * @return std::ostream& output stream
+   */
+  friend std::ostream& operator<<(std::ostream& os, const StaticSet& set) {
+    for (const_iterator b = set.begin(), e = set.end(); b != e; ++b) {
+      os << *b << "  ";
+    }
+    return os;
+  }
+
+ private:
+  // tentativi massimi per trovare il seed di un bucket
+  static constexpr std::ptrdiff_t _max_seed = 1 << 16;
+
+  /**
+   * @brief Combina l'hash dell'elemento con un seed (finalizzatore splitmix64)
+   *
+   * @param h hash dell'elemento
+   * @param seed seed del bucket (0 per scegliere il bucket)
+   * @return std::size_t hash rimescolato
+   */
+  static constexpr std::size_t _mix(std::size_t h, std::ptrdiff_t seed) {
+    std::uint64_t x =
+        static_cast<std::uint64_t>(h) ^
+        (static_cast<std::uint64_t>(seed) * 0x9E3779B97F4A7C15ull);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return static_cast<std::size_t>(x ^ (x >> 31));
+  }
+
+  /**
+   * @brief Ricerca tramite l'hash perfetto
+   *
+   * @tparam K tipo della chiave (value_type o chiave eterogenea)
+   * @param key chiave da cercare
+   * @return true se l'elemento nello slot è equivalente alla chiave
+   */
+  template <typename K>
+  constexpr bool _contains(const K& key) const {
+    Hash hasher;
+    Eql predic;
+    std::size_t h = hasher(key);
+    std::ptrdiff_t d = _displacements[_mix(h, 0) % N];
+    std::size_t slot =
+        (d < 0) ? static_cast<std::size_t>(-d - 1) : _mix(h, d) % N;
+    return predic(_elements[slot], key);
+  }
+
+  // elementi, ognuno nel suo slot
+  std::array<T, N> _elements;
+  // per ogni bucket: seed (>= 0) oppure slot diretto codificato come -slot-1
+  std::array<std::ptrdiff_t, N> _displacements;
+};
+
+/**
+ * @brief Costruisce uno StaticSet deducendo il numero di elementi
+ *
+ * @tparam T tipo del set
+ * @tparam Eql operatore di confronto constexpr
+ * @tparam Hash funzione di hash constexpr
+ * @tparam N numero di elementi (dedotto)
+ * @param elements elementi del set (es. make_static_set<int>({1, 2, 3}))
+ * @return StaticSet<T, N, Eql, Hash> il set costruito
+ */
+template <typename T, typename Eql = static_set_equal,
+          typename Hash = static_set_hash, std::size_t N>
+constexpr StaticSet<T, N, Eql, Hash> make_static_set(const T (&elements)[N]) {
+  return StaticSet<T, N, Eql, Hash>(elements);
+}
+
+/**
+ * @brief funzione globale che ritorna un nuovo set con elementi che rispettano
+ * un certo predicato P
+ *
+ * il risultato è un Set (a runtime) perchè la sua dimensione non è nota a
+ * compile time
+ *
+ * @tparam T tipo del set
+ * @tparam N numero di elementi dello StaticSet
+ * @tparam Eql operatore di confronto del set
+ * @tparam Hash funzione di hash dello StaticSet
+ * @tparam P predicato
+ * @param S il set sui cui elementi viene verificata la corrispondenza
+ * @param pred il predicato da applicare agli element del set
+ * @return Set<T, Eql> un nuovo set che contiene tutti gli elementi di S che
+ * soddisfano il prediato P
+ * @throws std::bad_alloc possibile eccezione di allocazione dato che la add
+ * contiene una new
+ */
+template <typename T, std::size_t N, typename Eql, typename Hash, typename P>
+Set<T, Eql> filter_out(const StaticSet<T, N, Eql, Hash>& S, P pred) {
+  Set<T, Eql> tmp;
+  try {
+    typename StaticSet<T, N, Eql, Hash>::const_iterator b, e;
+    for (b = S.begin(), e = S.end(); b != e; ++b) {
+      if (pred(*b)) tmp.add(*b);
+    }
+  } catch (...) {
+    tmp.clear();
+    throw;
+  }
+  return tmp;
+}
+
+#endif  // STATIC_SET_H
@@ -0,0 +1,432 @@
+/**
+ * @file trace.h
+ * @author Nidal Guerouaja
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>         // std::atomic
+#include <cstddef>        // std::size_t
+#include <cstdint>        // std::uint8_t, std::uint32_t, std::uint64_t
+#include <cstdio>         // std::FILE
+#include <cstring>        // std::memcmp
+#include <functional>     // std::hash
+#include <mutex>          // std::mutex, std::lock_guard
+#include <stdexcept>      // std::runtime_error
+#include <string>         // std::string
+#include <string_view>    // std::string_view
+#include <type_traits>    // std::is_integral_v, std::is_enum_v
+#include <unordered_map>  // std::unordered_map
+
+#include "set.h"
+
+/*
+ * Formato del file di trace (little endian):
+ * - header: "SETTRACE" seguito dalla versione (u32)
+ * - record da 13 byte: operazione (u8, valore di set_op), id del set (u32),
+ *   argomento (u64)
+ *
+ * Per add, remove e find l'argomento è la chiave dell'elemento, per le altre
+ * operazioni contiene gli id dei due operandi (primo << 32 | secondo, 0 se
+ * l'operando non c'è). Gli id partono da 1 e vengono assegnati alla prima
+ * operazione su ogni set; dopo destroy l'id non viene più usato.
+ */
+
+// versione del formato scritta nell'header
+constexpr std::uint32_t trace_version = 1;
+
+/**
+ * @brief Controlla se un'operazione si riferisce ad un elemento
+ *
+ * @param op operazione
+ * @return true per add, remove e find
+ */
+inline constexpr bool is_element_op(set_op op) {
+  return op == set_op::add || op == set_op::remove || op == set_op::find;
+}
+
+/**
+ * @brief Chiave scritta nella trace per un elemento
+ *
+ * gli interi vengono scritti così come sono, le stringhe (e tutto quello che
+ * si converte in std::string_view, così le chiavi eterogenee hanno la stessa
+ * chiave della std::string) con il loro hash, gli altri tipi con std::hash.
+ * Per tipi senza std::hash serve un funtore con la stessa interfaccia.
+ */
+struct trace_key {
+  template <typename K>
+  std::uint64_t operator()(const K& key) const {
+    if constexpr (std::is_integral_v<K> || std::is_enum_v<K>) {
+      return static_cast<std::uint64_t>(key);
+    } else if constexpr (std::is_convertible_v<const K&, std::string_view>) {
+      return std::hash<std::string_view>()(std::string_view(key));
+    } else {
+      return std::hash<K>()(key);
+    }
+  }
+};
+
+/**
+ * @brief Un record letto da una trace
+ */
+struct trace_record {
+  // operazione
+  set_op op;
+  // id del set su cui è fatta l'operazione (o del set risultato)
+  std::uint32_t set;
+  // chiave dell'elemento (solo add, remove e find)
+  std::uint64_t key;
+  // id del primo operando (0 se non c'è)
+  std::uint32_t a;
+  // id del secondo operando (0 se non c'è)
+  std::uint32_t b;
+};
+
+/**
+ * @brief Scrive una trace binaria
+ *
+ * Le scritture sono protette da un mutex, quindi lo stesso writer può essere
+ * usato da più thread (l'ordine dei record è quello in cui arrivano).
+ */
+class trace_writer {
+ public:
+  /**
+   * @brief Apre (o sovrascrive) il file e scrive l'header
+   *
+   * @param path percorso del file
+   * @throws std::runtime_error se il file non può essere aperto
+   */
+  explicit trace_writer(const std::string& path)
+      : _file(std::fopen(path.c_str(), "wb")), _next_id(1), _records(0) {
+    if (_file == nullptr) {
+      throw std::runtime_error("impossibile aprire la trace " + path);
+    }
+    unsigned char header[12];
+    std::memcpy(header, "SETTRACE", 8);
+    _put(header + 8, trace_version, 4);
+    std::fwrite(header, 1, sizeof(header), _file);
+  }
+
+  trace_writer(const trace_writer&) = delete;
+  trace_writer& operator=(const trace_writer&) = delete;
+
+  /**
+   * @brief Distruttore, chiude il file
+   */
+  ~trace_writer() {
+    std::fclose(_file);
+  }
+
+  /**
+   * @brief Scrive un'operazione su un elemento
+   *
+   * @param op operazione (add, remove o find)
+   * @param set set su cui è fatta l'operazione
+   * @param key chiave dell'elemento
+   */
+  void element(set_op op, const void* set, std::uint64_t key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _write(op, _id(set), key);
+  }
+
+  /**
+   * @brief Scrive un'operazione su interi set
+   *
+   * @param op operazione
+   * @param result set risultato (o set su cui viene fatta clear/destroy)
+   * @param a primo operando (nullptr se non c'è)
+   * @param b secondo operando (nullptr se non c'è)
+   */
+  void bulk(set_op op, const void* result, const void* a, const void* b) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    // un set che non compare nella trace non ha bisogno di destroy
+    if (op == set_op::destroy && _ids.find(result) == _ids.end()) return;
+    std::uint64_t operands = (std::uint64_t(_id(a)) << 32) | _id(b);
+    _write(op, _id(result), operands);
+    // l'indirizzo può essere riusato da un altro set
+    if (op == set_op::destroy) _ids.erase(result);
+  }
+
+  /**
+   * @brief Scrive su disco i record ancora nel buffer
+   */
+  void flush() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::fflush(_file);
+  }
+
+  /**
+   * @brief Numero di record scritti
+   */
+  std::size_t records() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _records;
+  }
+
+ private:
+  /**
+   * @brief Id di un set, assegnato alla prima operazione
+   *
+   * @param set indirizzo del set
+   * @return std::uint32_t id (0 per nullptr)
+   */
+  std::uint32_t _id(const void* set) {
+    if (set == nullptr) return 0;
+    std::unordered_map<const void*, std::uint32_t>::iterator it =
+        _ids.find(set);
+    if (it != _ids.end()) return it->second;
+    std::uint32_t id = _next_id++;
+    _ids.emplace(set, id);
+    return id;
+  }
+
+  /**
+   * @brief Scrive un record
+   */
+  void _write(set_op op, std::uint32_t set, std::uint64_t arg) {
+    unsigned char record[13];
+    record[0] = static_cast<unsigned char>(op);
+    _put(record + 1, set, 4);
+    _put(record + 5, arg, 8);
+    std::fwrite(record, 1, sizeof(record), _file);
+    _records++;
+  }
+
+  /**
+   * @brief Scrive un intero little endian
+   */
+  static void _put(unsigned char* out, std::uint64_t value, std::size_t bytes) {
+    for (std::size_t i = 0; i < bytes; ++i) {
+      out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+  }
+
+  std::FILE* _file;
+  mutable std::mutex _mutex;
+  std::unordered_map<const void*, std::uint32_t> _ids;
+  std::uint32_t _next_id;
+  std::size_t _records;
+};
+
+/**
+ * @brief Legge una trace scritta da trace_writer
+ */
+class trace_reader {
+ public:
+  /**
+   * @brief Apre il file e controlla l'header
+   *
+   * @param path percorso del file
+   * @throws std::runtime_error se il file non può essere aperto o non è una
+   * trace
+   */
+  explicit trace_reader(const std::string& path)
+      : _file(std::fopen(path.c_str(), "rb")) {
+    if (_file == nullptr) {
+      throw std::runtime_error("impossibile aprire la trace " + path);
+    }
+    unsigned char header[12];
+    if (std::fread(header, 1, sizeof(header), _file) != sizeof(header) ||
+        std::memcmp(header, "SETTRACE", 8) != 0) {
+      std::fclose(_file);
+      throw std::runtime_error(path + " non è una trace");
+    }
+    if (_get(header + 8, 4) != trace_version) {
+      std::fclose(_file);
+      throw std::runtime_error("versione della trace non supportata");
+    }
+  }
+
+  trace_reader(const trace_reader&) = delete;
+  trace_reader& operator=(const trace_reader&) = delete;
+
+  /**
+   * @brief Distruttore, chiude il file
+   */
+  ~trace_reader() {
+    std::fclose(_file);
+  }
+
+  /**
+   * @brief Legge il prossimo record
+   *
+   * @param r record letto
+   * @return false alla fine del file
+   * @throws std::runtime_error se il record non è valido
+   */
+  bool next(trace_record& r) {
+    unsigned char record[13];
+    std::size_t n = std::fread(record, 1, sizeof(record), _file);
+    if (n == 0) return false;
+    if (n != sizeof(record) ||
+        record[0] >= static_cast<unsigned char>(set_op::count)) {
+      throw std::runtime_error("record della trace non valido");
+    }
+    r.op = static_cast<set_op>(record[0]);
+    r.set = static_cast<std::uint32_t>(_get(record + 1, 4));
+    std::uint64_t arg = _get(record + 5, 8);
+    if (is_element_op(r.op)) {
+      r.key = arg;
+      r.a = r.b = 0;
+    } else {
+      r.key = 0;
+      r.a = static_cast<std::uint32_t>(arg >> 32);
+      r.b = static_cast<std::uint32_t>(arg);
+    }
+    return true;
+  }
+
+ private:
+  /**
+   * @brief Legge un intero little endian
+   */
+  static std::uint64_t _get(const unsigned char* in, std::size_t bytes) {
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < bytes; ++i) {
+      value |= std::uint64_t(in[i]) << (8 * i);
+    }
+    return value;
+  }
+
+  std::FILE* _file;
+};
+
+/**
+ * @brief Policy di instrumentation che registra le operazioni in una trace
+ *
+ * La registrazione parte con record_to(&writer) e finisce con
+ * stop_recording(); senza un writer le operazioni costano un controllo.
+ * Vengono registrate solo le operazioni chiamate dall'utente: le add fatte
+ * internamente da operator+ o filter_out, ad esempio, non finiscono nella
+ * trace perché la replay rifà l'intera operazione, e nemmeno quelle fatte
+ * dagli osservatori (es. il set interno di una FilterView). I set distrutti
+ * senza essere mai comparsi nella trace vengono ignorati. Allocazioni,
+ * scansioni e tempi vengono passati a Base, così si può registrare e contare
+ * insieme.
+ *
+ * @tparam KeyOf funtore che dà la chiave (u64) di un elemento
+ * @tparam Base policy a cui vengono inoltrati gli altri eventi
+ */
+template <typename KeyOf = trace_key, typename Base = no_instrumentation>
+struct tracing_instrumentation {
+  /**
+   * @brief Token di start(), tiene il conto delle operazioni annidate
+   */
+  class timer {
+   public:
+    timer() : _base(Base::start()) {
+      _depth()++;
+    }
+
+    ~timer() {
+      _depth()--;
+    }
+
+    timer(const timer&) = delete;
+    timer& operator=(const timer&) = delete;
+
+   private:
+    friend struct tracing_instrumentation;
+
+    typename Base::timer _base;
+  };
+
+  /**
+   * @brief Guardia del lavoro interno di Set (es. notifiche agli
+   * osservatori): le operazioni fatte nel frattempo non vengono registrate
+   */
+  class internal {
+   public:
+    explicit internal(set_op op) : _base(op) {
+      _depth()++;
+    }
+
+    ~internal() {
+      _depth()--;
+    }
+
+    internal(const internal&) = delete;
+    internal& operator=(const internal&) = delete;
+
+   private:
+    typename Base::internal _base;
+  };
+
+  /**
+   * @brief Inizia a registrare nella trace
+   *
+   * @param writer trace in cui scrivere, deve restare valido fino a
+   * stop_recording()
+   */
+  static void record_to(trace_writer* writer) {
+    _writer().store(writer, std::memory_order_release);
+  }
+
+  /**
+   * @brief Smette di registrare
+   */
+  static void stop_recording() {
+    _writer().store(nullptr, std::memory_order_release);
+  }
+
+  static void allocation(std::size_t bytes) {
+    Base::allocation(bytes);
+  }
+
+  static void scan(set_op op, std::size_t length) {
+    Base::scan(op, length);
+  }
+
+  static timer start() {
+    return timer();
+  }
+
+  static void stop(set_op op, const timer& t) {
+    Base::stop(op, t._base);
+  }
+
+  /**
+   * @brief Registra un'operazione su un elemento, se non è annidata
+   */
+  template <typename K>
+  static void element(set_op op, const void* set, const K& key) {
+    Base::element(op, set, key);
+    trace_writer* writer = _writer().load(std::memory_order_acquire);
+    if (writer != nullptr && _depth() == 0) {
+      writer->element(op, set, KeyOf()(key));
+    }
+  }
+
+  /**
+   * @brief Registra un'operazione su interi set, se non è annidata
+   */
+  static void bulk(set_op op, const void* result, const void* a,
+                   const void* b) {
+    Base::bulk(op, result, a, b);
+    // clear e destroy non hanno un timer, le altre hanno ancora il proprio
+    unsigned int outer =
+        (op == set_op::clear || op == set_op::destroy) ? 0 : 1;
+    trace_writer* writer = _writer().load(std::memory_order_acquire);
+    if (writer != nullptr && _depth() == outer) {
+      writer->bulk(op, result, a, b);
+    }
+  }
+
+ private:
+  // letto da tutti i thread che usano i set, quindi atomico
+  static std::atomic<trace_writer*>& _writer() {
+    static std::atomic<trace_writer*> writer(nullptr);
+    return writer;
+  }
+
+  static unsigned int& _depth() {
+    static thread_local unsigned int depth = 0;
+    return depth;
+  }
+};
+
+#endif  // TRACE_H
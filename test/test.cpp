@@ -1,11 +1,21 @@
+#include <algorithm>
 #include <cmath>
 #include <climits>
 #include <iostream>
+#include <new>
+#include <string_view>
+#include <thread>
 #include <tuple>
+#include <type_traits>
 #include <typeinfo>
 #include <vector>
 
+#include "../src/filter_view.h"
+#include "../src/instrumentation.h"
 #include "../src/set.h"
+#include "../src/sketch.h"
+#include "../src/static_set.h"
+#include "../src/trace.h"
 #include "gtest/gtest.h"
 
 /**
@@ -51,6 +61,20 @@ struct string_equal {
   }
 };
 
+/**
+ * @brief funtore stringhe uguali con confronto eterogeneo
+ *
+ * @return true sse la stringa e la chiave (std::string_view, const char*...)
+ * hanno lo stesso contenuto
+ */
+struct string_transparent_equal {
+  typedef void is_transparent;
+
+  bool operator()(const std::string& a, std::string_view b) {
+    return (a == b);
+  }
+};
+
 /**
  * @brief funtore stringhe di lunghezza pari
  *
@@ -254,3 +278,520 @@ TYPED_TEST(SetTest, Intersection) {
   result = this->set - other;
   EXPECT_EQ(result.size(), 1);
 }
+
+TYPED_TEST(SetTest, Contains) {
+  this->set.add(getvalue<typename TypeParam::My_type>(0));
+  this->set.add(getvalue<typename TypeParam::My_type>(1));
+  EXPECT_TRUE(this->set.contains(getvalue<typename TypeParam::My_type>(0)));
+  EXPECT_FALSE(this->set.contains(getvalue<typename TypeParam::My_type>(2)));
+  this->set.remove(getvalue<typename TypeParam::My_type>(0));
+  EXPECT_FALSE(this->set.contains(getvalue<typename TypeParam::My_type>(0)));
+}
+
+TEST(TransparentSetTest, HeterogeneousLookup) {
+  Set<std::string, string_transparent_equal> set;
+  const char buffer[] = "AlbertoAndrea";
+  std::string_view alberto(buffer, 7);
+  std::string_view andrea(buffer + 7, 6);
+
+  EXPECT_TRUE(set.add(alberto));
+  EXPECT_TRUE(set.add("Giovanni"));
+  EXPECT_FALSE(set.add(std::string("Alberto")));
+  EXPECT_EQ(set.size(), 2);
+
+  EXPECT_TRUE(set.contains(alberto));
+  EXPECT_FALSE(set.contains(andrea));
+  EXPECT_TRUE(set.contains("Giovanni"));
+
+  set.remove(andrea);
+  EXPECT_EQ(set.size(), 2);
+  set.remove(alberto);
+  EXPECT_EQ(set.size(), 1);
+  EXPECT_EQ(set[0], "Giovanni");
+}
+
+constexpr auto static_test_int =
+    make_static_set<int>({0, 1, INT_MAX, INT_MIN, -1, 42, 7, 1000});
+
+static_assert(static_test_int.size() == 8, "costruito a compile time");
+static_assert(static_test_int.contains(INT_MIN), "lookup a compile time");
+static_assert(!static_test_int.contains(2), "lookup a compile time");
+
+TEST(StaticSetTest, ContainsAll) {
+  for (int x : {0, 1, INT_MAX, INT_MIN, -1, 42, 7, 1000}) {
+    EXPECT_TRUE(static_test_int.contains(x));
+  }
+  for (int x : {2, 3, -2, 999, INT_MAX - 1}) {
+    EXPECT_FALSE(static_test_int.contains(x));
+  }
+}
+
+TEST(StaticSetTest, StringKeywords) {
+  static constexpr auto keywords = make_static_set<std::string_view>(
+      {"Alberto", "Andrea", "Giovanni", "Riccardo", "Lorenzo"});
+
+  EXPECT_EQ(keywords.size(), 5);
+  EXPECT_TRUE(keywords.contains("Giovanni"));
+  EXPECT_TRUE(keywords.contains(std::string("Lorenzo")));
+  EXPECT_FALSE(keywords.contains("Nidal"));
+
+  int count = 0;
+  for (std::string_view s : keywords) {
+    EXPECT_TRUE(keywords.contains(s));
+    count++;
+  }
+  EXPECT_EQ(count, 5);
+}
+
+// chiavi generate a compile time per un set più grande
+struct static_test_keys {
+  int values[2000];
+};
+
+constexpr static_test_keys make_static_test_keys() {
+  static_test_keys keys{};
+  for (int i = 0; i < 2000; ++i) keys.values[i] = i * 7919 - 1000000;
+  return keys;
+}
+
+constexpr static_test_keys static_test_large_keys = make_static_test_keys();
+constexpr StaticSet<int, 2000> static_test_large(
+    static_test_large_keys.values);
+
+TEST(StaticSetTest, LargeSetAndErrors) {
+  for (int x : static_test_large_keys.values) {
+    EXPECT_TRUE(static_test_large.contains(x));
+  }
+  EXPECT_FALSE(static_test_large.contains(1));
+
+  int duplicates[] = {1, 2, 3, 2};
+  EXPECT_THROW((StaticSet<int, 4>(duplicates)), std::logic_error);
+}
+
+TEST(StaticSetTest, FilterOut) {
+  Set<int, static_set_equal> result = filter_out(static_test_int, int_even());
+  EXPECT_EQ(result.size(), 4);
+  EXPECT_TRUE(result.contains(0));
+  EXPECT_TRUE(result.contains(1000));
+  EXPECT_FALSE(result.contains(7));
+}
+
+typedef Set<int, int_equal, minhash_hll_sketch<std::hash<int>>> SketchedSet;
+
+// senza sketch la classe base di Set è vuota (empty base optimization)
+static_assert(std::is_empty<set_sketch_base<no_sketch>>::value,
+              "no_sketch non occupa spazio");
+
+TEST(SketchTest, JaccardEstimate) {
+  SketchedSet a, b;
+  for (int i = 0; i < 400; ++i) a.add(i);
+  for (int i = 200; i < 600; ++i) b.add(i);
+
+  // |a ∩ b| / |a ∪ b| = 200 / 600
+  EXPECT_NEAR(jaccard_estimate(a, b), 1.0 / 3, 0.15);
+  EXPECT_DOUBLE_EQ(jaccard_estimate(a, a), 1.0);
+}
+
+TEST(SketchTest, UnionCardinalityEstimate) {
+  SketchedSet a, b, c;
+  for (int i = 0; i < 400; ++i) a.add(i);
+  for (int i = 200; i < 600; ++i) b.add(i);
+  for (int i = 500; i < 700; ++i) c.add(i);
+
+  EXPECT_NEAR(union_cardinality_estimate(a), 400, 40);
+  EXPECT_NEAR(union_cardinality_estimate(a, b, c), 700, 70);
+}
+
+TEST(SketchTest, RebuildAfterRemove) {
+  SketchedSet a, b;
+  for (int i = 0; i < 100; ++i) a.add(i);
+  for (int i = 0; i < 50; ++i) b.add(i);
+  EXPECT_LT(jaccard_estimate(a, b), 1.0);
+
+  for (int i = 50; i < 100; ++i) a.remove(i);
+  // lo sketch viene ricostruito una volta sola, anche da un set const
+  const SketchedSet& const_a = a;
+  const minhash_hll_sketch<std::hash<int>>& rebuilt = const_a.sketch();
+  EXPECT_DOUBLE_EQ(rebuilt.jaccard(b.sketch()), 1.0);
+  EXPECT_EQ(&a.sketch(), &rebuilt);
+  EXPECT_DOUBLE_EQ(jaccard_estimate(a, b), 1.0);
+  EXPECT_NEAR(union_cardinality_estimate(a), 50, 5);
+
+  // la copia riceve lo sketch di a, senza ricalcolarlo
+  a.remove(49);
+  SketchedSet copy(a);
+  EXPECT_DOUBLE_EQ(jaccard_estimate(copy, a), 1.0);
+  EXPECT_LT(jaccard_estimate(copy, b), 1.0);
+
+  a.clear();
+  EXPECT_NEAR(union_cardinality_estimate(a), 0, 0.5);
+}
+
+TYPED_TEST(SetTest, IntersectAll) {
+  typedef Set<typename TypeParam::My_type, typename TypeParam::My_type_eql>
+      set_type;
+  for (int i = 0; i < 4; ++i) {
+    this->set.add(getvalue<typename TypeParam::My_type>(i));
+  }
+  set_type b, c;
+  b.add(getvalue<typename TypeParam::My_type>(1));
+  b.add(getvalue<typename TypeParam::My_type>(2));
+  b.add(getvalue<typename TypeParam::My_type>(4));
+  c.add(getvalue<typename TypeParam::My_type>(2));
+  c.add(getvalue<typename TypeParam::My_type>(1));
+  c.add(getvalue<typename TypeParam::My_type>(0));
+
+  set_type result = intersect_all(this->set, b, c);
+  EXPECT_EQ(result.size(), 2);
+  EXPECT_TRUE(result.contains(getvalue<typename TypeParam::My_type>(1)));
+  EXPECT_TRUE(result.contains(getvalue<typename TypeParam::My_type>(2)));
+
+  std::vector<set_type> sets = {this->set, b, c, set_type()};
+  EXPECT_TRUE(intersect_all(sets).is_empty());
+  sets.pop_back();
+  EXPECT_EQ(intersect_all(sets.begin(), sets.end()).size(), 2);
+  EXPECT_EQ(intersect_all(this->set).size(), 4);
+}
+
+TYPED_TEST(SetTest, UnionAll) {
+  typedef Set<typename TypeParam::My_type, typename TypeParam::My_type_eql>
+      set_type;
+  this->set.add(getvalue<typename TypeParam::My_type>(0));
+  set_type b, c;
+  b.add(getvalue<typename TypeParam::My_type>(0));
+  b.add(getvalue<typename TypeParam::My_type>(1));
+  b.add(getvalue<typename TypeParam::My_type>(2));
+  c.add(getvalue<typename TypeParam::My_type>(2));
+  c.add(getvalue<typename TypeParam::My_type>(3));
+
+  EXPECT_EQ(union_all(this->set, b, c).size(), 4);
+
+  std::vector<set_type> sets = {this->set, b, c, set_type()};
+  EXPECT_EQ(union_all(sets).size(), 4);
+  EXPECT_EQ(union_all(sets.begin(), sets.begin() + 2).size(), 3);
+  EXPECT_TRUE(union_all(sets.begin(), sets.begin()).is_empty());
+}
+
+// senza viste un Set contiene solo la lista, la cardinalità e un puntatore
+// nullo agli osservatori
+static_assert(sizeof(Set<int, int_equal>) <= 3 * sizeof(void*),
+              "gli osservatori non occupano spazio finché non servono");
+
+TEST(FilterViewTest, TracksBase) {
+  Set<int, int_equal> base;
+  base.add(1);
+  base.add(2);
+  auto view = make_filter_view(base, int_even());
+  EXPECT_EQ(view.size(), 1);
+
+  for (int i = 3; i < 10; ++i) base.add(i);
+  EXPECT_EQ(view.size(), 4);
+  Set<int, int_equal> expected = filter_out(base, int_even());
+  EXPECT_EQ(view.size(), expected.size());
+  for (int x : expected) EXPECT_TRUE(view.set().contains(x));
+
+  // rimozione della coda e di un elemento che non soddisfa il predicato
+  base.remove(8);
+  base.remove(7);
+  EXPECT_EQ(view.size(), 3);
+  base.add(12);
+  EXPECT_EQ(view.set()[view.size() - 1], 12);
+  EXPECT_TRUE(view.set().contains(6));
+
+  base.clear();
+  EXPECT_TRUE(view.set().is_empty());
+  base.add(4);
+  EXPECT_EQ(view.size(), 1);
+}
+
+TEST(FilterViewTest, AssignmentAndDetach) {
+  Set<std::string, string_equal> other;
+  other.add("Alberto");
+  other.add("Andrea");
+  other.add("Riccardo");
+
+  auto* base = new Set<std::string, string_equal>();
+  base->add("Lorenzo");
+  auto view = make_filter_view(*base, string_evensize());
+  EXPECT_EQ(view.size(), 0);
+
+  *base = other;
+  EXPECT_EQ(view.size(), 2);
+  EXPECT_TRUE(view.is_attached());
+
+  delete base;
+  EXPECT_FALSE(view.is_attached());
+  EXPECT_EQ(view.size(), 2);
+}
+
+/**
+ * @brief osservatore che fallisce quando viene aggiunto un certo elemento
+ */
+struct failing_observer : SetObserver<int> {
+  explicit failing_observer(int value) : fail_on(value) {}
+
+  void on_add(const int& value) override {
+    if (value == fail_on) throw std::bad_alloc();
+  }
+  void on_remove(const int&) override {}
+  void on_clear() override {}
+  void on_detach() override {}
+
+  int fail_on;
+};
+
+TEST(FilterViewTest, FailedNotification) {
+  Set<int, int_equal> base;
+  base.add(2);
+  auto view = make_filter_view(base, int_even());
+  failing_observer failing(4);
+  base.subscribe(&failing);
+
+  // la vista è già stata avvisata, ma l'aggiunta viene annullata
+  EXPECT_THROW(base.add(4), std::bad_alloc);
+  EXPECT_FALSE(base.contains(4));
+  EXPECT_EQ(view.size(), 1);
+
+  Set<int, int_equal> other;
+  other.add(4);
+  other.add(6);
+  EXPECT_THROW(base = other, std::bad_alloc);
+  EXPECT_EQ(base.size(), 1);
+  EXPECT_EQ(view.size(), 1);
+  EXPECT_TRUE(view.set().contains(2));
+
+  base.unsubscribe(&failing);
+  base = other;
+  EXPECT_EQ(view.size(), 2);
+  EXPECT_TRUE(view.is_attached());
+}
+
+typedef Set<int, int_equal, no_sketch, counting_instrumentation> CountedSet;
+
+TEST(InstrumentationTest, CountsAllocationsAndScans) {
+  counting_instrumentation::reset();
+
+  CountedSet set;
+  set.add(1);
+  set.add(2);
+  set.add(3);
+  set.add(2);
+  set_stats stats = counting_instrumentation::stats();
+  EXPECT_EQ(stats.allocations, 3);
+  EXPECT_GT(stats.allocated_bytes, 0);
+  EXPECT_EQ(stats.calls[set_op_index(set_op::add)], 4);
+  // 0 + 1 + 2 + 2 nodi visitati
+  EXPECT_EQ(stats.scanned[set_op_index(set_op::add)], 5);
+  EXPECT_EQ(stats.max_scan[set_op_index(set_op::add)], 2);
+
+  EXPECT_TRUE(set.contains(3));
+  stats = counting_instrumentation::stats();
+  EXPECT_EQ(stats.scanned[set_op_index(set_op::find)], 3);
+
+  set.remove(4);
+  stats = counting_instrumentation::stats();
+  EXPECT_EQ(stats.max_scan[set_op_index(set_op::remove)], 3);
+}
+
+TEST(InstrumentationTest, TimesSetOperations) {
+  CountedSet a, b;
+  for (int i = 0; i < 10; ++i) a.add(i);
+  for (int i = 5; i < 15; ++i) b.add(i);
+  counting_instrumentation::reset();
+
+  EXPECT_EQ((a + b).size(), 15);
+  EXPECT_EQ((a - b).size(), 5);
+  EXPECT_EQ(filter_out(a, int_even()).size(), 5);
+  set_stats stats = counting_instrumentation::stats();
+  EXPECT_EQ(stats.calls[set_op_index(set_op::unite)], 1);
+  EXPECT_EQ(stats.calls[set_op_index(set_op::intersect)], 1);
+  EXPECT_EQ(stats.calls[set_op_index(set_op::filter)], 1);
+  // copia di a (10) + elementi nuovi di b (5) + intersezione (5) + filtro (5)
+  EXPECT_EQ(stats.allocations, 25);
+  // le add e le ricerche interne non sono chiamate dell'utente
+  EXPECT_EQ(stats.calls[set_op_index(set_op::add)], 0);
+  EXPECT_EQ(stats.calls[set_op_index(set_op::find)], 0);
+  EXPECT_GT(stats.scanned[set_op_index(set_op::intersect)], 0);
+}
+
+TEST(InstrumentationTest, CountsEveryCallAndComparison) {
+  CountedSet a, b, empty;
+  for (int i = 0; i < 4; ++i) a.add(i);
+  for (int i = 3; i >= 0; --i) b.add(i);
+  std::vector<CountedSet> none;
+  counting_instrumentation::reset();
+
+  // ogni chiamata viene contata, anche quelle che escono subito
+  EXPECT_TRUE(intersect_all(none.begin(), none.end()).is_empty());
+  EXPECT_TRUE(intersect_all(a, empty).is_empty());
+  EXPECT_TRUE(union_all(none.begin(), none.end()).is_empty());
+  set_stats stats = counting_instrumentation::stats();
+  EXPECT_EQ(stats.calls[set_op_index(set_op::intersect)], 2);
+  EXPECT_EQ(stats.calls[set_op_index(set_op::unite)], 1);
+
+  // una ricerca per elemento: 4 + 3 + 2 + 1 confronti, nessuna chiamata
+  counting_instrumentation::reset();
+  EXPECT_TRUE(a == b);
+  stats = counting_instrumentation::stats();
+  EXPECT_EQ(stats.calls[set_op_index(set_op::find)], 0);
+  EXPECT_EQ(stats.scanned[set_op_index(set_op::find)], 10);
+
+  // i confronti di intersect_all sono dell'intersezione
+  counting_instrumentation::reset();
+  EXPECT_EQ(intersect_all(a, b).size(), 4);
+  stats = counting_instrumentation::stats();
+  EXPECT_EQ(stats.calls[set_op_index(set_op::find)], 0);
+  EXPECT_EQ(stats.scanned[set_op_index(set_op::intersect)], 10);
+
+  b.remove(0);
+  b.add(7);
+  EXPECT_FALSE(a == b);
+}
+
+TEST(InstrumentationTest, ObserverWorkBelongsToTheOperation) {
+  CountedSet base;
+  for (int i = 0; i < 10; ++i) base.add(i);
+  auto view = make_filter_view(base, int_even());
+  counting_instrumentation::reset();
+
+  // la remove sul set interno della vista non è una seconda chiamata
+  base.remove(8);
+  set_stats stats = counting_instrumentation::stats();
+  EXPECT_EQ(stats.calls[set_op_index(set_op::remove)], 1);
+  // 9 nodi della base + 5 nodi della vista
+  EXPECT_EQ(stats.scanned[set_op_index(set_op::remove)], 14);
+  EXPECT_EQ(view.size(), 4);
+}
+
+TEST(InstrumentationTest, OnlyOuterCopiesAreReported) {
+  CountedSet a, b, c;
+  for (int i = 0; i < 10; ++i) a.add(i);
+  for (int i = 5; i < 15; ++i) c.add(i);
+  counting_instrumentation::reset();
+
+  b = a;
+  set_stats stats = counting_instrumentation::stats();
+  EXPECT_EQ(stats.calls[set_op_index(set_op::copy)], 1);
+
+  // operator+ e union_all partono da una copia, che fa parte dell'unione
+  counting_instrumentation::reset();
+  EXPECT_EQ((a + c).size(), 15);
+  EXPECT_EQ(union_all(a, b, c).size(), 15);
+  stats = counting_instrumentation::stats();
+  EXPECT_EQ(stats.calls[set_op_index(set_op::copy)], 0);
+  EXPECT_EQ(stats.nanoseconds[set_op_index(set_op::copy)], 0);
+  EXPECT_EQ(stats.calls[set_op_index(set_op::unite)], 2);
+}
+
+TEST(InstrumentationTest, TotalOfAllThreads) {
+  set_stats before = counting_instrumentation::total();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([]() {
+      CountedSet set;
+      for (int i = 0; i < 100; ++i) set.add(i);
+    });
+  }
+  CountedSet set;
+  set.add(1);
+  for (std::thread& t : threads) t.join();
+
+  set_stats after = counting_instrumentation::total();
+  EXPECT_EQ(after.calls[set_op_index(set_op::add)] -
+                before.calls[set_op_index(set_op::add)],
+            401);
+  EXPECT_EQ(after.allocations - before.allocations, 401);
+  EXPECT_GE(after.max_scan[set_op_index(set_op::add)], 99);
+}
+
+typedef tracing_instrumentation<> tracing;
+typedef Set<int, int_equal, no_sketch, tracing> TracedSet;
+
+/**
+ * @brief tutti i record di una trace
+ */
+std::vector<trace_record> read_trace(const std::string& path) {
+  std::vector<trace_record> records;
+  trace_reader reader(path);
+  trace_record r;
+  while (reader.next(r)) records.push_back(r);
+  return records;
+}
+
+TEST(TraceTest, RecordsUserOperations) {
+  std::string path = ::testing::TempDir() + "set_trace_test.bin";
+  {
+    trace_writer writer(path);
+    tracing::record_to(&writer);
+    {
+      TracedSet a, b;
+      a.add(1);
+      a.add(2);
+      b.add(2);
+      EXPECT_TRUE(a.contains(2));
+      TracedSet c = a + b;
+      a.remove(1);
+    }
+    tracing::stop_recording();
+  }
+
+  std::vector<trace_record> records = read_trace(path);
+  ASSERT_GE(records.size(), 6);
+  EXPECT_EQ(records[0].op, set_op::add);
+  EXPECT_EQ(records[0].set, 1);
+  EXPECT_EQ(records[0].key, 1);
+  EXPECT_EQ(records[1].key, 2);
+  EXPECT_EQ(records[2].op, set_op::add);
+  EXPECT_EQ(records[2].set, 2);
+  EXPECT_EQ(records[3].op, set_op::find);
+  // le add fatte da operator+ non vengono registrate
+  EXPECT_EQ(records[4].op, set_op::unite);
+  EXPECT_EQ(records[4].a, 1);
+  EXPECT_EQ(records[4].b, 2);
+  EXPECT_EQ(std::count_if(records.begin(), records.end(),
+                          [](const trace_record& x) {
+                            return x.op == set_op::add;
+                          }),
+            3);
+  EXPECT_EQ(records[5].op, set_op::remove);
+  EXPECT_EQ(records.back().op, set_op::destroy);
+  EXPECT_EQ(records.back().set, 1);
+}
+
+TEST(TraceTest, NoInternalRecords) {
+  std::string path = ::testing::TempDir() + "set_trace_internal.bin";
+  {
+    trace_writer writer(path);
+    tracing::record_to(&writer);
+    {
+      TracedSet a;
+      a.add(1);
+      a.add(2);
+      auto view = make_filter_view(a, int_even());
+      a.remove(2);
+      a.add(4);
+      EXPECT_EQ(view.size(), 1);
+    }
+    tracing::stop_recording();
+  }
+
+  // solo le operazioni dell'utente su a: niente clear alla distruzione e
+  // niente operazioni sul set interno della vista
+  std::vector<trace_record> records = read_trace(path);
+  ASSERT_EQ(records.size(), 5);
+  for (const trace_record& r : records) {
+    EXPECT_EQ(r.set, 1);
+    EXPECT_NE(r.op, set_op::clear);
+  }
+  EXPECT_EQ(records[2].op, set_op::remove);
+  EXPECT_EQ(records.back().op, set_op::destroy);
+}
+
+TEST(TraceTest, StringKeys) {
+  trace_key key;
+  EXPECT_EQ(key(42), 42);
+  EXPECT_EQ(key(std::string("abc")), key("abc"));
+  EXPECT_EQ(key(std::string("abc")), key(std::string_view("abc")));
+  EXPECT_NE(key(std::string("abc")), key(std::string("abd")));
+}